@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include "ScratchWorld.cpp"
+
+#define ACCESS_CHECK_SIZE 4
+#define ACCESS_CHECK_LAYER 40
+#define ACCESS_CHECK_ROUNDS 200
+
+// Hammers WorldAccess from the reader and the writer threads while the main thread applies the edits
+// and keeps inserting and erasing chunks, then checks that no edit was lost and no snapshot was torn
+class AccessCheck {
+public:
+    static bool run(uint32_t seed) {
+        ScratchWorld world;
+        createWorld();
+
+        const int32_t width = ACCESS_CHECK_SIZE * CHUNK_WIDTH;
+        const uint32_t edits = width * width;
+
+        std::atomic<bool> done(false);
+        std::atomic<uint64_t> reads(0);
+        std::atomic<uint64_t> snapshots(0);
+        std::atomic<uint32_t> torn(0);
+
+        // Readers also look at the chunks which come and go, those lookups race with the map changes
+        auto reader = [&](uint32_t id) {
+            std::minstd_rand random(seed + id);
+            std::vector<uint32_t> blocks;
+            uint64_t count = 0;
+            while(!done.load(std::memory_order_relaxed)) {
+                int32_t x = CHECK_ORIGIN * CHUNK_WIDTH + random() % (width + CHUNK_WIDTH);
+                int32_t z = CHECK_ORIGIN * CHUNK_WIDTH + random() % width;
+                WorldAccess::readBlock(x, ACCESS_CHECK_LAYER, z);
+                count++;
+
+                if(count % 64 == 0) {
+                    int32_t chunkX = CHECK_ORIGIN + random() % ACCESS_CHECK_SIZE;
+                    int32_t chunkY = CHECK_ORIGIN + random() % ACCESS_CHECK_SIZE;
+                    uint32_t revision = 0;
+                    if(WorldAccess::snapshot(chunkX, chunkY, blocks, &revision)) {
+                        // Every write of the check places one block, so the blocks and the revision must agree
+                        if(countPlaced(blocks) != revision || WorldAccess::revision(chunkX, chunkY) < revision) {
+                            torn.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        snapshots.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+            reads.fetch_add(count, std::memory_order_relaxed);
+        };
+
+        // Every block of the layer is placed exactly once, the writers share the positions between them
+        const uint32_t writerCount = 2;
+        auto writer = [&](uint32_t id) {
+            std::minstd_rand random(seed + 100 + id);
+            for(uint32_t i = id; i < edits; i += writerCount) {
+                WorldAccess::queueEdit(CHECK_ORIGIN * CHUNK_WIDTH + i % width, ACCESS_CHECK_LAYER, CHECK_ORIGIN * CHUNK_WIDTH + i / width, BlockType::Planks);
+                if(random() % 32 == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        };
+
+        uint32_t readerCount = MAX(2U, std::thread::hardware_concurrency());
+        std::vector<std::thread> threads;
+        for(uint32_t i = 0; i < readerCount; i++) {
+            threads.emplace_back(reader, i);
+        }
+        for(uint32_t i = 0; i < writerCount; i++) {
+            threads.emplace_back(writer, i);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        uint32_t applied = 0;
+        float editTime = 0.0f;
+        for(uint32_t round = 0; round < ACCESS_CHECK_ROUNDS; round++) {
+            applied += applyEdits();
+            if(applied == edits && editTime == 0.0f) {
+                editTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+            }
+            toggleChunks(round % 2 == 0);
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        toggleChunks(false);
+
+        done = true;
+        for(auto &it : threads) {
+            it.join();
+        }
+        applied += applyEdits();
+
+        std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+
+        uint32_t missing = 0;
+        ScratchWorld::forEachChunk(ACCESS_CHECK_SIZE, [&missing](ChunkData &data) {
+            missing += CHUNK_WIDTH * CHUNK_WIDTH - countPlaced(data.blocks);
+        });
+
+        float seconds = MAX(elapsed.count(), 0.0001f);
+        aInfo() << "Access check:" << int(readerCount) << "readers," << int(writerCount) << "writers," << int(ACCESS_CHECK_ROUNDS) << "rounds," << int(missing) << "lost edits," << int(torn.load()) << "torn snapshots";
+        aInfo() << "Access check:" << float(reads.load()) / seconds << "reads/s," << float(snapshots.load()) / seconds << "snapshots/s," << applied / MAX(editTime, 0.0001f) << "edits/s";
+
+        if(applied != edits || missing > 0) {
+            aError() << "Access check failed:" << int(applied) << "of" << int(edits) << "edits applied," << int(missing) << "blocks missing";
+        }
+        if(torn.load() > 0) {
+            aError() << "Access check failed:" << int(torn.load()) << "snapshots didn't match their revision";
+        }
+        return applied == edits && missing == 0 && torn.load() == 0;
+    }
+
+protected:
+    static uint32_t countPlaced(const std::vector<uint32_t> &blocks) {
+        uint32_t result = 0;
+        for(int32_t i = 0; i < CHUNK_WIDTH * CHUNK_WIDTH; i++) {
+            size_t index = ACCESS_CHECK_LAYER * CHUNK_WIDTH * CHUNK_WIDTH + i;
+            if(index < blocks.size() && ChunkRenderer::unpackType(blocks[index]) == BlockType::Planks) {
+                result++;
+            }
+        }
+        return result;
+    }
+
+    // Same as the world tick does with the queued edits, only the blocks of the check are written
+    static uint32_t applyEdits() {
+        uint32_t result = 0;
+        BlockEdit *edits = s_edits.takeAll();
+        for(BlockEdit *edit = edits; edit; edit = edit->next) {
+            auto it = s_chunks.find(ChunkData::posToIndex(edit->x / CHUNK_WIDTH, edit->z / CHUNK_WIDTH));
+            if(it == s_chunks.end()) {
+                continue;
+            }
+
+            uint32_t block = 0;
+            ChunkRenderer::packType(block, edit->type);
+            it->second.write(ChunkData::blockIndex(edit->x % CHUNK_WIDTH, edit->y, edit->z % CHUNK_WIDTH), block);
+            result++;
+        }
+        EditQueue::release(edits);
+        return result;
+    }
+
+    // A row of chunks next to the check area is loaded and unloaded, enough of them to make the map rehash
+    static void toggleChunks(bool load) {
+        for(int32_t i = 0; i < 64; i++) {
+            if(load) {
+                ScratchWorld::createChunk(ACCESS_CHECK_SIZE + i / ACCESS_CHECK_SIZE, i % ACCESS_CHECK_SIZE);
+            } else {
+                ScratchWorld::eraseChunk(ACCESS_CHECK_SIZE + i / ACCESS_CHECK_SIZE, i % ACCESS_CHECK_SIZE);
+            }
+        }
+    }
+
+    static void createWorld() {
+        for(int32_t i = 0; i < ACCESS_CHECK_SIZE; i++) {
+            for(int32_t j = 0; j < ACCESS_CHECK_SIZE; j++) {
+                ChunkData &data = ScratchWorld::createChunk(i, j);
+                for(int32_t k = 0; k < ACCESS_CHECK_LAYER * CHUNK_WIDTH * CHUNK_WIDTH; k++) {
+                    data.blocks[k] = (uint32_t)BlockType::Stone;
+                }
+                data.recount();
+            }
+        }
+    }
+
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <queue>
+#include <random>
+
+#include "ChunkRenderer.cpp"
+
+typedef void (*TreeGenerator)(int32_t x, int32_t y, int32_t z);
+
+class BlockTicker {
+    struct ScheduledTick {
+        uint64_t tick;
+        int32_t x;
+        int32_t y;
+        int32_t z;
+
+        bool operator>(const ScheduledTick &other) const {
+            return tick > other.tick;
+        }
+    };
+
+    std::priority_queue<ScheduledTick, std::vector<ScheduledTick>, std::greater<ScheduledTick>> m_scheduled;
+
+    std::minstd_rand m_random;
+
+    TreeGenerator m_treeGenerator = nullptr;
+
+    uint32_t m_randomTickSpeed = 3;
+    uint32_t m_saplingChance = 7;
+    uint64_t m_tick = 0;
+
+public:
+    void clear() {
+        m_scheduled = decltype(m_scheduled)();
+        m_tick = 0;
+    }
+
+    void setTreeGenerator(TreeGenerator generator) {
+        m_treeGenerator = generator;
+    }
+
+    // Requests a tick for the block after the given number of ticks
+    void scheduleTick(int32_t x, int32_t y, int32_t z, uint32_t delay) {
+        m_scheduled.push({m_tick + delay, x, y, z});
+    }
+
+    // Called once per world tick
+    void tick() {
+        m_tick++;
+
+        while(!m_scheduled.empty() && m_scheduled.top().tick <= m_tick) {
+            ScheduledTick scheduled = m_scheduled.top();
+            m_scheduled.pop();
+
+            tickBlock(scheduled.x, scheduled.y, scheduled.z);
+        }
+
+        if(m_randomTickSpeed == 0) {
+            return;
+        }
+
+        for(auto &it : s_chunks) {
+            ChunkData &data = it.second;
+            for(int32_t s = 0; s < SECTIONS; s++) {
+                // Sections without grass or saplings have nothing to do
+                if(data.tickable[s] == 0) {
+                    continue;
+                }
+
+                for(uint32_t i = 0; i < m_randomTickSpeed; i++) {
+                    uint32_t r = m_random();
+                    int32_t x = r & (CHUNK_WIDTH - 1);
+                    int32_t z = (r >> 4) & (CHUNK_WIDTH - 1);
+                    int32_t y = s * SECTION_HEIGHT + ((r >> 8) & (SECTION_HEIGHT - 1));
+
+                    if(ChunkData::isTickable(ChunkRenderer::unpackType(data.blocks[ChunkData::blockIndex(x, y, z)]))) {
+                        tickBlock(data.x * CHUNK_WIDTH + x, y, data.y * CHUNK_WIDTH + z);
+                    }
+                }
+            }
+        }
+    }
+
+    uint64_t currentTick() const {
+        return m_tick;
+    }
+
+    uint32_t randomTickSpeed() const {
+        return m_randomTickSpeed;
+    }
+
+    void setRandomTickSpeed(uint32_t speed) {
+        m_randomTickSpeed = speed;
+    }
+
+protected:
+    void tickBlock(int32_t x, int32_t y, int32_t z) {
+        uint32_t *block = blockAt(x, y, z);
+        if(block == nullptr) {
+            return;
+        }
+
+        switch(ChunkRenderer::unpackType(*block)) {
+        case BlockType::Grass: {
+            if(isCovered(x, y, z)) {
+                setBlock(x, y, z, BlockType::Dirt);
+                break;
+            }
+
+            // Spread to the random dirt block nearby
+            uint32_t r = m_random();
+            int32_t nx = x + int32_t(r % 3) - 1;
+            int32_t ny = y + int32_t((r >> 4) % 5) - 3;
+            int32_t nz = z + int32_t((r >> 8) % 3) - 1;
+
+            uint32_t *target = blockAt(nx, ny, nz);
+            if(target && ChunkRenderer::unpackType(*target) == BlockType::Dirt && !isCovered(nx, ny, nz)) {
+                setBlock(nx, ny, nz, BlockType::Grass);
+            }
+        } break;
+        case BlockType::Dirt: {
+            if(isCovered(x, y, z)) {
+                break;
+            }
+            // Exposed dirt picks up grass from any neighbour
+            const int32_t offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+            for(auto &it : offsets) {
+                for(int32_t dy = -1; dy <= 1; dy++) {
+                    uint32_t *neighbour = blockAt(x + it[0], y + dy, z + it[1]);
+                    if(neighbour && ChunkRenderer::unpackType(*neighbour) == BlockType::Grass) {
+                        setBlock(x, y, z, BlockType::Grass);
+                        return;
+                    }
+                }
+            }
+        } break;
+        case BlockType::Sapling: {
+            // The trunk replaces the sapling, the generator leaves it alone if the tree doesn't fit
+            if(m_treeGenerator && (m_random() % m_saplingChance) == 0) {
+                m_treeGenerator(x, y, z);
+            }
+        } break;
+        default: break;
+        }
+    }
+
+    bool isCovered(int32_t x, int32_t y, int32_t z) {
+        uint32_t *above = blockAt(x, y + 1, z);
+        if(above == nullptr) {
+            return false;
+        }
+
+        BlockType type = ChunkRenderer::unpackType(*above);
+        return (type != BlockType::Air && type != BlockType::TallGrass && type != BlockType::Sapling && type != BlockType::Leaves);
+    }
+
+    void setBlock(int32_t x, int32_t y, int32_t z, BlockType type) {
+        auto it = s_chunks.find(ChunkData::posToIndex(x / CHUNK_WIDTH, z / CHUNK_WIDTH));
+
+        uint32_t block = 0;
+        ChunkRenderer::packType(block, type);
+        it->second.write(ChunkData::blockIndex(x % CHUNK_WIDTH, y, z % CHUNK_WIDTH), block);
+
+        markBlockDirty(x, y, z);
+    }
+
+};
+
+static BlockTicker s_ticker;
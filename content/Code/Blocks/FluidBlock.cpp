@@ -0,0 +1,54 @@
+#pragma once
+
+#include "SolidBlock.cpp"
+
+class FluidBlock : public SolidBlock {
+public:
+    static bool isFluid(BlockType type) {
+        return (type == BlockType::FlowingWater || type == BlockType::Water ||
+                type == BlockType::FlowingLava || type == BlockType::Lava);
+    }
+
+    static bool isLava(BlockType type) {
+        return (type == BlockType::FlowingLava || type == BlockType::Lava);
+    }
+
+    static bool isSource(BlockType type) {
+        return (type == BlockType::Water || type == BlockType::Lava);
+    }
+
+    static bool isSameFluid(BlockType type, BlockType other) {
+        return isFluid(type) && isFluid(other) && isLava(type) == isLava(other);
+    }
+
+    bool isCollidable() const override {
+        return false;
+    }
+
+    void GenerateUvs(std::vector<Vector2>& uvs, BlockType type, Sides side, uint32_t v) override {
+        int x0 = 13;
+        int y0 = 3;
+
+        if (isLava(type)) {
+            y0 = 1;
+        }
+
+        float x1 = x0 * tileWidth;
+        float x2 = (x0 + 1) * tileWidth;
+
+        float y1 = y0 * tileHeight;
+        float y2 = (y0 + 1) * tileHeight;
+
+        uvs[v].x = x1;
+        uvs[v].y = y1;
+
+        uvs[v + 1].x = x1;
+        uvs[v + 1].y = y2;
+
+        uvs[v + 2].x = x2;
+        uvs[v + 2].y = y1;
+
+        uvs[v + 3].x = x2;
+        uvs[v + 3].y = y2;
+    }
+};
@@ -46,6 +46,12 @@ public:
         Front = (1 << 5)
     };
 
+    enum Opacity {
+        Opaque,
+        Cutout,
+        Translucent
+    };
+
     const float tileMapWidth = 256.0f;
     const float tileMapHeight = 256.0f;
 
@@ -53,10 +59,33 @@ public:
     const float tileHeight = 16.0f / tileMapWidth;
 
 public:
+    // Opaque blocks hide all the neighbour faces, cutout and translucent ones only the faces of the same type.
+    // Air and plants are never meshed as cubes so they count as cutout.
+    static Opacity opacity(BlockType type) {
+        switch (type) {
+        case BlockType::Air:
+        case BlockType::Sapling:
+        case BlockType::TallGrass:
+        case BlockType::DeadBush:
+        case BlockType::Leaves:
+        case BlockType::Glass: return Cutout;
+        case BlockType::FlowingWater:
+        case BlockType::Water:
+        case BlockType::FlowingLava:
+        case BlockType::Lava: return Translucent;
+        default: break;
+        }
+        return Opaque;
+    }
+
     virtual bool isCollidable() const {
         return true;
     }
 
+    virtual bool isInstanced() const {
+        return false;
+    }
+
     virtual void buildGeometry(Mesh &mesh, BlockType type, int8_t mask, int32_t x, int32_t y, int32_t z) {
         int8_t count = 0;
         int8_t localMask = mask;
@@ -64,16 +93,17 @@ public:
             localMask &= (localMask - 1);
         }
 
-        Vector3Vector vertices;
-        vertices.resize(count * 4);
+        // Faces are written in place, the mesh keeps its capacity between rebuilds so nothing is allocated here
+        uint32_t v = mesh.vertices().size();
+        uint32_t i = v;
 
-        Vector2Vector uvs;
-        uvs.resize(count * 4);
-        
-        Vector4Vector colors = Vector4Vector(count * 4, Vector4(1.0f));
-        
-        uint32_t v = 0;
-        uint32_t i = mesh.vertices().size();
+        Vector3Vector &vertices = mesh.vertices();
+        vertices.resize(v + count * 4);
+
+        Vector2Vector &uvs = mesh.uv0();
+        uvs.resize(v + count * 4);
+
+        mesh.colors().resize(v + count * 4, Vector4(1.0f));
 
         if (mask & Top) {
             vertices[v].x = x;
@@ -219,10 +249,6 @@ public:
 
             addIndices(mesh.indices(), i);
         }
-
-        mesh.vertices().insert(mesh.vertices().end(), vertices.begin(), vertices.end());
-        mesh.uv0().insert(mesh.uv0().end(), uvs.begin(), uvs.end());
-        mesh.colors().insert(mesh.colors().end(), colors.begin(), colors.end());
     }
 
     virtual void GenerateUvs(std::vector<Vector2>& uvs, BlockType type, Sides side, uint32_t v) {
@@ -231,10 +257,14 @@ public:
         switch (type) {
         case BlockType::Stone: x0 = 1; y0 = 15; break;
         case BlockType::Dirt: x0 = 2; y0 = 15; break;
+        case BlockType::Planks: x0 = 4; y0 = 15; break;
+        case BlockType::Cobblestone: x0 = 0; y0 = 14; break;
         case BlockType::Bedrock: x0 = 1; y0 = 14; break;
+        case BlockType::Gravel: x0 = 3; y0 = 14; break;
+        case BlockType::Glass: x0 = 1; y0 = 12; break;
         case BlockType::GoldOre: x0 = 0; y0 = 13; break;
         case BlockType::IronOre: x0 = 1; y0 = 13; break;
-        case BlockType::CoalOre: x0 = 1; y0 = 13; break;
+        case BlockType::CoalOre: x0 = 2; y0 = 13; break;
         case BlockType::Leaves: x0 = 4; y0 = 12; break;
         default: break;
         }
@@ -3,11 +3,46 @@
 #include "SolidBlock.cpp"
 
 class VegetationBlock : public SolidBlock {
+    std::unordered_map<BlockType, Mesh *> m_instanceMeshes;
+
 public:
     bool isCollidable() const override {
         return false;
     }
 
+    bool isInstanced() const override {
+        return true;
+    }
+
+    // Cross quads for the block type built once at the origin and shared by all the instances
+    Mesh *instanceMesh(BlockType type) {
+        auto it = m_instanceMeshes.find(type);
+        if (it != m_instanceMeshes.end()) {
+            return it->second;
+        }
+
+        Mesh *mesh = Engine::objectCreate<Mesh>("VegetationInstance");
+        buildGeometry(*mesh, type, 0, 0, 0, 0);
+        m_instanceMeshes[type] = mesh;
+
+        return mesh;
+    }
+
+    void buildInstance(Mesh &mesh, BlockType type, int32_t x, int32_t y, int32_t z) {
+        Mesh *shared = instanceMesh(type);
+
+        uint32_t base = mesh.vertices().size();
+        Vector3 offset(x, y, z);
+        for (auto &it : shared->vertices()) {
+            mesh.vertices().push_back(it + offset);
+        }
+        mesh.uv0().insert(mesh.uv0().end(), shared->uv0().begin(), shared->uv0().end());
+        mesh.colors().insert(mesh.colors().end(), shared->colors().begin(), shared->colors().end());
+        for (auto it : shared->indices()) {
+            mesh.indices().push_back(base + it);
+        }
+    }
+
     void buildGeometry(Mesh &mesh, BlockType type, int8_t mask, int32_t x, int32_t y, int32_t z) override {
         Vector3Vector vertices;
         vertices.resize(8);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <prefab.h>
+
+#include <algorithm>
+
+#include "ChunkRenderer.cpp"
+
+// Recycles the chunk actors together with their renderers and mesh buffers instead of cloning the prefab again
+class ChunkPool {
+    std::vector<ChunkRenderer *> m_free;
+    std::vector<ChunkRenderer *> m_active;
+
+    uint32_t m_hits = 0;
+    uint32_t m_misses = 0;
+
+public:
+    ChunkRenderer *acquire(Prefab *prefab, Object *parent) {
+        ChunkRenderer *chunk = nullptr;
+        if(!m_free.empty()) {
+            chunk = m_free.back();
+            m_free.pop_back();
+            chunk->actor()->setEnabled(true);
+            m_hits++;
+        } else {
+            Actor *object = static_cast<Actor *>(prefab->actor()->clone(parent));
+            chunk = object->getComponent<ChunkRenderer>();
+            if(chunk == nullptr) {
+                return nullptr;
+            }
+            m_misses++;
+        }
+
+        m_active.push_back(chunk);
+        return chunk;
+    }
+
+    void release(ChunkRenderer *chunk) {
+        auto it = std::find(m_active.begin(), m_active.end(), chunk);
+        if(it == m_active.end()) {
+            return;
+        }
+        *it = m_active.back();
+        m_active.pop_back();
+
+        chunk->resetChunkData();
+        chunk->actor()->setEnabled(false);
+        m_free.push_back(chunk);
+    }
+
+    void releaseAll() {
+        while(!m_active.empty()) {
+            release(m_active.back());
+        }
+    }
+
+    uint32_t hits() const {
+        return m_hits;
+    }
+
+    uint32_t misses() const {
+        return m_misses;
+    }
+
+    float hitRate() const {
+        uint32_t total = m_hits + m_misses;
+        return (total > 0) ? float(m_hits) / total : 0.0f;
+    }
+
+    // Memory held by the mesh buffers of all the pooled chunks, in use or not
+    size_t residentBytes() const {
+        size_t result = 0;
+        for(auto it : m_active) {
+            result += it->residentBytes();
+        }
+        for(auto it : m_free) {
+            result += it->residentBytes();
+        }
+        return result;
+    }
+
+};
@@ -6,18 +6,54 @@
 #include <meshrender.h>
 #include <meshcollider.h>
 #include <transform.h>
+#include <camera.h>
 
 #include <mesh.h>
 #include <log.h>
 
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
+#include <mutex>
+#include <shared_mutex>
+
 #include "Blocks/GrassBlock.cpp"
 #include "Blocks/VegetationBlock.cpp"
+#include "Blocks/FluidBlock.cpp"
+
+#include "EditJournal.cpp"
 
 #define CHUNK_WIDTH 16
 #define CHUNK_HEIGHT 256
+#define SECTION_HEIGHT 16
+#define SECTIONS (CHUNK_HEIGHT / SECTION_HEIGHT)
+#define SECTIONS_MASK ((1U << SECTIONS) - 1)
+
+#define VEGETATION_DISTANCE 48.0f
+#define TRANSLUCENT_SORT_DISTANCE 32.0f
+#define TRANSLUCENT_SORT_CELL 4.0f
 
 class ChunkRenderer;
 
+// Off while the players move with the voxel physics, the chunks don't need the collider meshes then
+static bool s_meshColliders = true;
+
+static void markBlockDirty(int32_t x, int32_t y, int32_t z);
+
+// Copying the chunk data never shares the lock
+struct ChunkLock {
+    ChunkLock() {}
+    ChunkLock(const ChunkLock &) {}
+    ChunkLock &operator=(const ChunkLock &) { return *this; }
+
+    std::shared_mutex mutex;
+};
+
+struct StructureSite {
+    uint32_t index;
+    uint8_t type;
+};
+
 struct ChunkData {
     static uint64_t posToIndex(int32_t x, int32_t y) {
         uint64_t index = x;
@@ -25,13 +61,158 @@ struct ChunkData {
         return index;
     }
 
+    static size_t blockIndex(int32_t x, int32_t y, int32_t z) {
+        return x + CHUNK_WIDTH * (y * CHUNK_WIDTH + z);
+    }
+
+    static bool isTickable(BlockType type) {
+        return (type == BlockType::Grass || type == BlockType::Sapling);
+    }
+
+    // Full cube which hides the faces of the neighbours
+    static bool isOpaque(BlockType type) {
+        return SolidBlock::opacity(type) == SolidBlock::Opaque;
+    }
+
+    // Keeps the section counters and the column heights up to date
+    void onBlockChanged(size_t index, BlockType oldType, BlockType newType) {
+        int32_t y = index / (CHUNK_WIDTH * CHUNK_WIDTH);
+        int32_t s = y / SECTION_HEIGHT;
+        size_t column = columnIndex(index);
+
+        if(isTickable(oldType)) {
+            tickable[s]--;
+        }
+        if(isTickable(newType)) {
+            tickable[s]++;
+        }
+
+        if(oldType != BlockType::Air) {
+            filled[s]--;
+        }
+        if(newType != BlockType::Air) {
+            filled[s]++;
+            height[column] = MAX(height[column], int16_t(y));
+        } else if(height[column] == y) {
+            height[column] = findTop(column, y - 1, false);
+        }
+
+        if(isOpaque(oldType)) {
+            opaque[s]--;
+        }
+        if(isOpaque(newType)) {
+            opaque[s]++;
+            opaqueHeight[column] = MAX(opaqueHeight[column], int16_t(y));
+        } else if(opaqueHeight[column] == y) {
+            opaqueHeight[column] = findTop(column, y - 1, true);
+        }
+    }
+
+    // Must be called after the blocks were written directly, bypassing write()
+    void recount() {
+        for(int32_t s = 0; s < SECTIONS; s++) {
+            tickable[s] = 0;
+            filled[s] = 0;
+            opaque[s] = 0;
+        }
+        for(size_t i = 0; i < blocks.size(); i++) {
+            BlockType type = (BlockType)(blocks[i] & 0xff);
+            int32_t s = i / (CHUNK_WIDTH * CHUNK_WIDTH * SECTION_HEIGHT);
+            if(isTickable(type)) {
+                tickable[s]++;
+            }
+            if(type != BlockType::Air) {
+                filled[s]++;
+            }
+            if(isOpaque(type)) {
+                opaque[s]++;
+            }
+        }
+        for(size_t c = 0; c < CHUNK_WIDTH * CHUNK_WIDTH; c++) {
+            height[c] = findTop(c, CHUNK_HEIGHT - 1, false);
+            opaqueHeight[c] = findTop(c, height[c], true);
+        }
+    }
+
+    // Highest section with any blocks, -1 for the empty chunk
+    int32_t topSection() const {
+        for(int32_t s = SECTIONS - 1; s >= 0; s--) {
+            if(filled[s] > 0) {
+                return s;
+            }
+        }
+        return -1;
+    }
+
+    bool isSectionOpaque(int32_t s) const {
+        return (s < 0 || (s < SECTIONS && opaque[s] == CHUNK_WIDTH * CHUNK_WIDTH * SECTION_HEIGHT));
+    }
+
+    // Block writes are done by the main thread only, other threads must read under the shared lock
+    void write(size_t index, uint32_t block) {
+        uint32_t old = exchange(index, block);
+        s_journal.append(x, y, index, old, block);
+    }
+
+    // Same as write() but not journaled, applies the records read from the journal
+    uint32_t exchange(size_t index, uint32_t block) {
+        std::unique_lock<std::shared_mutex> guard(lock.mutex);
+
+        uint32_t old = blocks[index];
+        blocks[index] = block;
+        onBlockChanged(index, (BlockType)(old & 0xff), (BlockType)(block & 0xff));
+        revision++;
+        return old;
+    }
+
+    static size_t columnIndex(size_t index) {
+        return index % (CHUNK_WIDTH * CHUNK_WIDTH);
+    }
+
+    int16_t findTop(size_t column, int32_t from, bool opaqueOnly) const {
+        for(int32_t y = from; y >= 0; y--) {
+            BlockType type = (BlockType)(blocks[column + y * CHUNK_WIDTH * CHUNK_WIDTH] & 0xff);
+            if(opaqueOnly ? isOpaque(type) : type != BlockType::Air) {
+                return y;
+            }
+        }
+        return -1;
+    }
+
     std::vector<uint32_t> blocks;
+    std::vector<StructureSite> sites;
+    uint16_t tickable[SECTIONS] = {};
+    uint16_t filled[SECTIONS] = {};
+    uint16_t opaque[SECTIONS] = {};
+    // Highest non air and highest opaque block of every column, -1 if there are none
+    int16_t height[CHUNK_WIDTH * CHUNK_WIDTH] = {};
+    int16_t opaqueHeight[CHUNK_WIDTH * CHUNK_WIDTH] = {};
+    uint32_t revision = 0;
     int32_t x;
     int32_t y;
     ChunkRenderer *renderer = nullptr;
+    mutable ChunkLock lock;
 };
 
 static std::unordered_map<uint64_t, ChunkData> s_chunks;
+// The main thread inserts and erases chunks under the exclusive lock, other threads look them up under the shared one
+static std::shared_mutex s_chunksLock;
+
+// Dirty sections of every chunk waiting for the rebuild, one bit per section
+static std::unordered_map<uint64_t, uint32_t> s_dirtySections;
+
+static uint32_t *blockAt(int32_t x, int32_t y, int32_t z) {
+    if(x < 0 || z < 0 || y < 0 || y >= CHUNK_HEIGHT) {
+        return nullptr;
+    }
+
+    auto it = s_chunks.find(ChunkData::posToIndex(x / CHUNK_WIDTH, z / CHUNK_WIDTH));
+    if(it == s_chunks.end()) {
+        return nullptr;
+    }
+
+    return &it->second.blocks[ChunkData::blockIndex(x % CHUNK_WIDTH, y, z % CHUNK_WIDTH)];
+}
 
 static const std::unordered_map<BlockType, SolidBlock*> s_blockTypes = {
     {BlockType::Stone, new SolidBlock},
@@ -41,10 +222,10 @@ static const std::unordered_map<BlockType, SolidBlock*> s_blockTypes = {
     {BlockType::Sapling, new VegetationBlock},
     {BlockType::Planks, new SolidBlock},
     {BlockType::Bedrock, new SolidBlock},
-    //FlowingWater
-    //Water
-    //FlowingLava
-    //Lava
+    {BlockType::FlowingWater, new FluidBlock},
+    {BlockType::Water, new FluidBlock},
+    {BlockType::FlowingLava, new FluidBlock},
+    {BlockType::Lava, new FluidBlock},
     {BlockType::Sand, new SolidBlock},
     {BlockType::Gravel, new SolidBlock},
     {BlockType::GoldOre, new SolidBlock},
@@ -52,40 +233,164 @@ static const std::unordered_map<BlockType, SolidBlock*> s_blockTypes = {
     {BlockType::CoalOre, new SolidBlock},
     {BlockType::Log, new GrassBlock},
     {BlockType::Leaves, new SolidBlock},
+    {BlockType::Glass, new SolidBlock},
     //...........
     {BlockType::TallGrass, new VegetationBlock},
 };
 
+struct VegetationInstance {
+    uint32_t index;
+    BlockType type;
+};
+
+struct MeshBuffers {
+    Vector3Vector vertices;
+    Vector2Vector uv0;
+    Vector4Vector colors;
+    IndexVector indices;
+
+    void store(Mesh &mesh) {
+        vertices = mesh.vertices();
+        uv0 = mesh.uv0();
+        colors = mesh.colors();
+        indices = mesh.indices();
+    }
+
+    void restore(Mesh &mesh) const {
+        mesh.clear();
+        mesh.setVertices(vertices);
+        mesh.setUv0(uv0);
+        mesh.setColors(colors);
+        mesh.setIndices(indices);
+    }
+};
+
+// Ready built geometry of the chunk, restoring it skips the meshing of all the blocks
+struct ChunkMeshCache {
+    MeshBuffers solid;
+    MeshBuffers translucent;
+    std::vector<VegetationInstance> instances;
+    std::vector<uint32_t> sections;
+};
+
 class ChunkRenderer : public NativeBehaviour {
     A_OBJECT(ChunkRenderer, NativeBehaviour, Components)
 
+    A_PROPERTIES(
+        A_PROPERTY(MeshRender *, vegetationRender, ChunkRenderer::vegetationRender, ChunkRenderer::setVegetationRender),
+        A_PROPERTY(MeshRender *, translucentRender, ChunkRenderer::translucentRender, ChunkRenderer::setTranslucentRender)
+    )
+
     ChunkData *m_chunkData = nullptr;
 
     Mesh *m_chunkMesh = nullptr;
     Mesh *m_solidMesh = nullptr;
+    Mesh *m_translucentMesh = nullptr;
     Mesh *m_vegetationMesh = nullptr;
     MeshCollider *m_collider = nullptr;
     MeshRender *m_render = nullptr;
+    MeshRender *m_vegetationRender = nullptr;
+    MeshRender *m_translucentRender = nullptr;
+
+    std::vector<VegetationInstance> m_instances;
+    std::unordered_map<uint32_t, uint32_t> m_instanceSlots;
+
+    uint32_t m_vegetationStep = 1;
+
+    // Camera position in chunk space and its sort cell at the moment of the last sort
+    Vector3 m_sortPosition;
+    int32_t m_sortCell[3] = {INT32_MIN, INT32_MIN, INT32_MIN};
+    std::vector<std::pair<float, uint32_t>> m_sortKeys;
+
+    // Geometry is emitted in the section order, these are the starts of every section in the meshes
+    uint32_t m_solidVertices[SECTIONS + 1] = {};
+    uint32_t m_solidIndices[SECTIONS + 1] = {};
+    uint32_t m_translucentVertices[SECTIONS + 1] = {};
+    bool m_sectionsValid = false;
+
+    // Neighbour chunks which were missing when the chunk was meshed, their borders were closed
+    uint8_t m_missingNeighbours = 0;
+
+    Mesh *m_sectionSolidMesh = nullptr;
+    Mesh *m_sectionTranslucentMesh = nullptr;
 
 public:
+    enum Neighbours {
+        West = (1 << 0),
+        East = (1 << 1),
+        North = (1 << 2),
+        South = (1 << 3)
+    };
+
     ChunkRenderer() :
             m_chunkMesh(Engine::objectCreate<Mesh>("ChunkMesh")),
             m_solidMesh(Engine::objectCreate<Mesh>("SolidMesh")),
-            m_vegetationMesh(Engine::objectCreate<Mesh>("VegetationMesh")) {
+            m_translucentMesh(Engine::objectCreate<Mesh>("TranslucentMesh")),
+            m_vegetationMesh(Engine::objectCreate<Mesh>("VegetationMesh")),
+            m_sectionSolidMesh(Engine::objectCreate<Mesh>("SectionSolidMesh")),
+            m_sectionTranslucentMesh(Engine::objectCreate<Mesh>("SectionTranslucentMesh")) {
 
         m_chunkMesh->makeDynamic();
+        m_vegetationMesh->makeDynamic();
+        m_translucentMesh->makeDynamic();
     }
 
     void start() override {
         m_collider = getComponent<MeshCollider>();
-        if (m_collider) {
-            m_collider->setMesh(m_solidMesh);
-        }
+        updateCollider();
 
         m_render = getComponent<MeshRender>();
         if (m_render) {
             m_render->setMesh(m_chunkMesh);
         }
+        if (m_vegetationRender) {
+            m_vegetationRender->setMesh(m_vegetationMesh);
+        }
+        if (m_translucentRender) {
+            m_translucentRender->setMesh(m_translucentMesh);
+        }
+    }
+
+    void update() override {
+        Camera *camera = Camera::current();
+        if (camera == nullptr || m_chunkData == nullptr) {
+            return;
+        }
+
+        Vector3 center = transform()->position() + Vector3(CHUNK_WIDTH * 0.5f, 0.0f, CHUNK_WIDTH * 0.5f);
+        Vector3 delta = camera->transform()->worldPosition() - center;
+        delta.y = 0.0f;
+
+        // Distant chunks keep only every second, fourth or none of the plants
+        float distance = delta.length();
+        uint32_t step = 1;
+        if (distance > VEGETATION_DISTANCE * 3.0f) {
+            step = 0;
+        } else if (distance > VEGETATION_DISTANCE * 2.0f) {
+            step = 4;
+        } else if (distance > VEGETATION_DISTANCE) {
+            step = 2;
+        }
+
+        if (step != m_vegetationStep) {
+            m_vegetationStep = step;
+            RebuildVegetation();
+        }
+
+        // Only the chunks around the camera keep their translucent faces sorted, and only when the camera moves to another cell
+        if (distance < TRANSLUCENT_SORT_DISTANCE && !m_translucentMesh->indices().empty()) {
+            Vector3 local = camera->transform()->worldPosition() - transform()->position();
+            int32_t cell[3] = {int32_t(floorf(local.x / TRANSLUCENT_SORT_CELL)), int32_t(floorf(local.y / TRANSLUCENT_SORT_CELL)), int32_t(floorf(local.z / TRANSLUCENT_SORT_CELL))};
+            if (cell[0] != m_sortCell[0] || cell[1] != m_sortCell[1] || cell[2] != m_sortCell[2]) {
+                for (int32_t i = 0; i < 3; i++) {
+                    m_sortCell[i] = cell[i];
+                }
+                m_sortPosition = local;
+                sortTranslucent();
+                // Marks the mesh as changed, otherwise the old index buffer stays on the GPU
+                batchTranslucent();
+            }
+        }
     }
 
     void setChunkData(ChunkData &data) {
@@ -95,25 +400,224 @@ public:
         RebuildChunk();
     }
 
-    void RebuildChunk() {
+    void setChunkData(ChunkData &data, const ChunkMeshCache &cache) {
+        m_chunkData = &data;
+        m_chunkData->renderer = this;
+
+        cache.solid.restore(*m_solidMesh);
+        cache.translucent.restore(*m_translucentMesh);
+
+        m_instances = cache.instances;
+        m_instanceSlots.clear();
+        for (uint32_t i = 0; i < m_instances.size(); i++) {
+            m_instanceSlots[m_instances[i].index] = i;
+        }
+
+        m_sectionsValid = (cache.sections.size() == (SECTIONS + 1) * 3);
+        if (m_sectionsValid) {
+            for (int32_t i = 0; i <= SECTIONS; i++) {
+                m_solidVertices[i] = cache.sections[i];
+                m_solidIndices[i] = cache.sections[SECTIONS + 1 + i];
+                m_translucentVertices[i] = cache.sections[(SECTIONS + 1) * 2 + i];
+            }
+        }
+        m_missingNeighbours = findMissingNeighbours();
+
+        updateCollider();
+
+        sortTranslucent();
+        batchTranslucent();
+        batchChunkMesh();
+        RebuildVegetation();
+    }
+
+    void exportMeshes(ChunkMeshCache &cache) const {
+        cache.solid.store(*m_solidMesh);
+        cache.translucent.store(*m_translucentMesh);
+        cache.instances = m_instances;
+
+        cache.sections.clear();
+        if (m_sectionsValid) {
+            cache.sections.insert(cache.sections.end(), m_solidVertices, m_solidVertices + SECTIONS + 1);
+            cache.sections.insert(cache.sections.end(), m_solidIndices, m_solidIndices + SECTIONS + 1);
+            cache.sections.insert(cache.sections.end(), m_translucentVertices, m_translucentVertices + SECTIONS + 1);
+        }
+    }
+
+    // Detaches the renderer from its chunk, clearing keeps the capacity of the buffers for the next chunk
+    void resetChunkData() {
+        if (m_chunkData && m_chunkData->renderer == this) {
+            m_chunkData->renderer = nullptr;
+        }
+        m_chunkData = nullptr;
+
         m_solidMesh->clear();
+        m_translucentMesh->clear();
         m_vegetationMesh->clear();
         m_chunkMesh->clear();
+        m_instances.clear();
+        m_instanceSlots.clear();
+        m_vegetationStep = 1;
+        m_sectionsValid = false;
+        m_missingNeighbours = 0;
+        for (int32_t i = 0; i < 3; i++) {
+            m_sortCell[i] = INT32_MIN;
+        }
+    }
 
-        for (uint32_t y = 0; y < CHUNK_HEIGHT; y++) {
-            for (uint32_t x = 0; x < CHUNK_WIDTH; x++) {
-                for (uint32_t z = 0; z < CHUNK_WIDTH; z++) {
-                    GenerateBlock(x, y, z);
+    size_t residentBytes() const {
+        size_t result = m_instances.capacity() * sizeof(VegetationInstance);
+        for (Mesh *mesh : {m_chunkMesh, m_solidMesh, m_translucentMesh, m_vegetationMesh, m_sectionSolidMesh, m_sectionTranslucentMesh}) {
+            result += mesh->vertices().capacity() * sizeof(Vector3);
+            result += mesh->uv0().capacity() * sizeof(Vector2);
+            result += mesh->colors().capacity() * sizeof(Vector4);
+            result += mesh->indices().capacity() * sizeof(uint32_t);
+        }
+        return result;
+    }
+
+    void RebuildChunk() {
+        s_dirtySections.erase(ChunkData::posToIndex(m_chunkData->x, m_chunkData->y));
+
+        m_solidMesh->clear();
+        m_translucentMesh->clear();
+        m_instances.clear();
+        m_instanceSlots.clear();
+
+        // Only the sections up to the topmost occupied one are meshed, the ones above it stay empty
+        int32_t top = m_chunkData->topSection();
+        for (int32_t s = 0; s <= SECTIONS; s++) {
+            m_solidVertices[s] = m_solidMesh->vertices().size();
+            m_solidIndices[s] = m_solidMesh->indices().size();
+            m_translucentVertices[s] = m_translucentMesh->vertices().size();
+
+            if (s <= top) {
+                GenerateSection(s);
+            }
+        }
+        m_sectionsValid = true;
+
+        m_missingNeighbours = findMissingNeighbours();
+
+        updateCollider();
+
+        sortTranslucent();
+        batchTranslucent();
+        batchChunkMesh();
+        RebuildVegetation();
+    }
+
+    // Remeshes only the sections in the mask and splices them into the chunk geometry
+    void RebuildSections(uint32_t mask) {
+        if (!m_sectionsValid || (mask & SECTIONS_MASK) == SECTIONS_MASK) {
+            RebuildChunk();
+            return;
+        }
+
+        int32_t top = m_chunkData->topSection();
+        for (int32_t s = 0; s < SECTIONS; s++) {
+            if ((mask & (1 << s)) == 0) {
+                continue;
+            }
+
+            for (uint32_t i = m_instances.size(); i > 0; i--) {
+                uint32_t index = m_instances[i - 1].index;
+                if (int32_t(index / (CHUNK_WIDTH * CHUNK_WIDTH * SECTION_HEIGHT)) == s) {
+                    removeInstance(index);
                 }
             }
+
+            // Above the top there is nothing to mesh, only the geometry left from before has to go
+            if (s > top && isSectionEmpty(s)) {
+                continue;
+            }
+
+            // The section is meshed on its own into the scratch meshes
+            std::swap(m_solidMesh, m_sectionSolidMesh);
+            std::swap(m_translucentMesh, m_sectionTranslucentMesh);
+            m_solidMesh->clear();
+            m_translucentMesh->clear();
+
+            GenerateSection(s);
+
+            std::swap(m_solidMesh, m_sectionSolidMesh);
+            std::swap(m_translucentMesh, m_sectionTranslucentMesh);
+
+            spliceSection(*m_solidMesh, *m_sectionSolidMesh, m_solidVertices, m_solidIndices, s);
+            spliceSection(*m_translucentMesh, *m_sectionTranslucentMesh, m_translucentVertices, nullptr, s);
         }
 
+        updateCollider();
+
+        sortTranslucent();
+        batchTranslucent();
+        batchChunkMesh();
+        RebuildVegetation();
+    }
+
+    bool isSectionEmpty(int32_t s) const {
+        return (m_solidVertices[s] == m_solidVertices[s + 1] && m_translucentVertices[s] == m_translucentVertices[s + 1]);
+    }
+
+    uint8_t missingNeighbours() const {
+        return m_missingNeighbours;
+    }
+
+    void updateCollider() {
         if (m_collider) {
-            m_collider->setMesh(m_solidMesh);
+            m_collider->setEnabled(s_meshColliders);
+            if (s_meshColliders) {
+                m_collider->setMesh(m_solidMesh);
+            }
         }
+    }
+
+    static void setMeshColliders(bool enabled) {
+        if (s_meshColliders == enabled) {
+            return;
+        }
+        s_meshColliders = enabled;
+        for (auto &it : s_chunks) {
+            if (it.second.renderer) {
+                it.second.renderer->updateCollider();
+            }
+        }
+    }
+
+    // Expands the vegetation instances into their own mesh, the chunk mesh stays untouched
+    void RebuildVegetation() {
+        m_vegetationMesh->clear();
+
+        if (m_vegetationStep > 0) {
+            for (auto &it : m_instances) {
+                // Stable hash keeps the same plants while thinning
+                if (((it.index * 2654435761U) >> 16) % m_vegetationStep != 0) {
+                    continue;
+                }
+
+                auto block = s_blockTypes.find(it.type);
+                if (block != s_blockTypes.end()) {
+                    uint32_t x = it.index % CHUNK_WIDTH;
+                    uint32_t z = (it.index / CHUNK_WIDTH) % CHUNK_WIDTH;
+                    uint32_t y = it.index / (CHUNK_WIDTH * CHUNK_WIDTH);
+
+                    static_cast<VegetationBlock *>(block->second)->buildInstance(*m_vegetationMesh, it.type, x, y, z);
+                }
+            }
+        }
+
+        m_vegetationMesh->recalcNormals();
+        m_vegetationMesh->recalcBounds();
 
+        if (m_vegetationRender) {
+            m_vegetationRender->setMesh(m_vegetationMesh);
+        }
+    }
+
+    // Solid geometry only, the plants and the translucent faces have their own renderers
+    void batchChunkMesh() {
+        m_chunkMesh->clear();
         m_chunkMesh->batchMesh(*m_solidMesh);
-        m_chunkMesh->batchMesh(*m_vegetationMesh);
 
         m_chunkMesh->recalcNormals();
         m_chunkMesh->recalcBounds();
@@ -123,45 +627,75 @@ public:
         }
     }
 
-    void changeBlock(int32_t x, int32_t y, int32_t z, BlockType newType) {
-        int chunkX = x / CHUNK_WIDTH;
-        int chunkY = z / CHUNK_WIDTH;
+    // Translucent faces are blended without the depth writes, the mesh is rendered as is
+    void batchTranslucent() {
+        m_translucentMesh->recalcNormals();
+        m_translucentMesh->recalcBounds();
 
-        uint32_t x0 = x % CHUNK_WIDTH;
-        uint32_t z0 = z % CHUNK_WIDTH;
-        size_t index = x0 + CHUNK_WIDTH * (y * CHUNK_WIDTH + z0);
+        if (m_translucentRender) {
+            m_translucentRender->setMesh(m_translucentMesh);
+        }
+    }
 
-        if(m_chunkData && unpackType(m_chunkData->blocks[index]) != BlockType::Bedrock) {
-            packType(m_chunkData->blocks[index], newType);
+    // Orders the translucent quads back to front for the last camera position, only the indices are rewritten
+    void sortTranslucent() {
+        Vector3Vector &vertices = m_translucentMesh->vertices();
+        IndexVector &indices = m_translucentMesh->indices();
 
-            RebuildChunk();
+        // Every quad is built from its own 4 vertices, the indices are regenerated from scratch
+        uint32_t quads = vertices.size() / 4;
+        indices.resize(quads * 6);
 
-            if (x0 == 0) {
-                auto it = s_chunks.find(ChunkData::posToIndex(chunkX - 1, chunkY));
-                if (it != s_chunks.end()) {
-                    it->second.renderer->RebuildChunk();
-                }
-            }
-            else if (x0 == CHUNK_WIDTH - 1) {
-                auto it = s_chunks.find(ChunkData::posToIndex(chunkX + 1, chunkY));
-                if (it != s_chunks.end()) {
-                    it->second.renderer->RebuildChunk();
-                }
-            }
+        m_sortKeys.resize(quads);
+        for (uint32_t q = 0; q < quads; q++) {
+            Vector3 center = (vertices[q * 4] + vertices[q * 4 + 3]) * 0.5f;
+            m_sortKeys[q] = {(center - m_sortPosition).sqrLength(), q};
+        }
+        std::sort(m_sortKeys.begin(), m_sortKeys.end(), [](const std::pair<float, uint32_t> &a, const std::pair<float, uint32_t> &b) {
+            return a.first > b.first;
+        });
+
+        for (uint32_t q = 0; q < quads; q++) {
+            uint32_t i = m_sortKeys[q].second * 4;
+            uint32_t *quad = &indices[q * 6];
+            quad[0] = i;
+            quad[1] = i + 1;
+            quad[2] = i + 2;
+            quad[3] = i + 1;
+            quad[4] = i + 3;
+            quad[5] = i + 2;
+        }
+    }
 
-            if (z0 == 0) {
-                auto it = s_chunks.find(ChunkData::posToIndex(chunkX, chunkY - 1));
-                if (it != s_chunks.end()) {
-                    it->second.renderer->RebuildChunk();
-                }
-            }
-            else if (z0 == CHUNK_WIDTH - 1) {
-                auto it = s_chunks.find(ChunkData::posToIndex(chunkX, chunkY + 1));
-                if (it != s_chunks.end()) {
-                    it->second.renderer->RebuildChunk();
-                }
-            }
+    // Plants don't affect the solid geometry so only their instance slot has to be updated,
+    // returns false if the change needs a remesh
+    bool updateInstance(uint32_t index, BlockType oldType, BlockType newType) {
+        if(!isInstanceOrAir(oldType) || !isInstanceOrAir(newType)) {
+            return false;
+        }
+
+        removeInstance(index);
+        if(newType != BlockType::Air) {
+            addInstance(index, newType);
         }
+        RebuildVegetation();
+        return true;
+    }
+
+    MeshRender *vegetationRender() const {
+        return m_vegetationRender;
+    }
+
+    void setVegetationRender(MeshRender *render) {
+        m_vegetationRender = render;
+    }
+
+    MeshRender *translucentRender() const {
+        return m_translucentRender;
+    }
+
+    void setTranslucentRender(MeshRender *render) {
+        m_translucentRender = render;
     }
 
     static void packType(uint32_t& block, BlockType type) {
@@ -169,10 +703,90 @@ public:
     }
 
     static BlockType unpackType(uint32_t block) {
-        return (BlockType)block;
+        return (BlockType)(block & 0xff);
+    }
+
+    static void packLevel(uint32_t& block, uint8_t level) {
+        block = (block & 0xff) | (uint32_t(level & 0x0f) << 8);
+    }
+
+    static uint8_t unpackLevel(uint32_t block) {
+        return (block >> 8) & 0x0f;
     }
 
 protected:
+    // Empty and buried sections are skipped entirely, columns stop at their top block
+    void GenerateSection(int32_t s) {
+        if (m_chunkData->filled[s] == 0 || isSectionBuried(s)) {
+            return;
+        }
+        for (int32_t y = s * SECTION_HEIGHT; y < (s + 1) * SECTION_HEIGHT; y++) {
+            for (uint32_t x = 0; x < CHUNK_WIDTH; x++) {
+                for (uint32_t z = 0; z < CHUNK_WIDTH; z++) {
+                    if (y <= m_chunkData->height[x + z * CHUNK_WIDTH]) {
+                        GenerateBlock(x, y, z);
+                    }
+                }
+            }
+        }
+    }
+
+    // Replaces the geometry of the section s, the following sections are shifted
+    static void spliceSection(Mesh &mesh, Mesh &section, uint32_t *vertexStarts, uint32_t *indexStarts, int32_t s) {
+        uint32_t begin = vertexStarts[s];
+        uint32_t end = vertexStarts[s + 1];
+        int32_t delta = int32_t(section.vertices().size()) - int32_t(end - begin);
+
+        Vector3Vector &vertices = mesh.vertices();
+        vertices.erase(vertices.begin() + begin, vertices.begin() + end);
+        vertices.insert(vertices.begin() + begin, section.vertices().begin(), section.vertices().end());
+
+        Vector2Vector &uvs = mesh.uv0();
+        uvs.erase(uvs.begin() + begin, uvs.begin() + end);
+        uvs.insert(uvs.begin() + begin, section.uv0().begin(), section.uv0().end());
+
+        Vector4Vector &colors = mesh.colors();
+        colors.erase(colors.begin() + begin, colors.begin() + end);
+        colors.insert(colors.begin() + begin, section.colors().begin(), section.colors().end());
+
+        if (indexStarts) {
+            IndexVector &indices = mesh.indices();
+            uint32_t first = indexStarts[s];
+            uint32_t last = indexStarts[s + 1];
+            indices.erase(indices.begin() + first, indices.begin() + last);
+            for (uint32_t i = first; i < indices.size(); i++) {
+                indices[i] += delta;
+            }
+
+            IndexVector &added = section.indices();
+            for (auto &it : added) {
+                it += begin;
+            }
+            indices.insert(indices.begin() + first, added.begin(), added.end());
+
+            int32_t indexDelta = int32_t(added.size()) - int32_t(last - first);
+            for (int32_t t = s + 1; t <= SECTIONS; t++) {
+                indexStarts[t] += indexDelta;
+            }
+        }
+
+        for (int32_t t = s + 1; t <= SECTIONS; t++) {
+            vertexStarts[t] += delta;
+        }
+    }
+
+    uint8_t findMissingNeighbours() const {
+        const int32_t offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+        uint8_t result = 0;
+        for (int32_t i = 0; i < 4; i++) {
+            if (s_chunks.find(ChunkData::posToIndex(m_chunkData->x + offsets[i][0], m_chunkData->y + offsets[i][1])) == s_chunks.end()) {
+                result |= (1 << i);
+            }
+        }
+        return result;
+    }
+
     void GenerateBlock(uint32_t x, uint32_t y, uint32_t z) {
         BlockType type = unpackType(GetBlockAtPosition(x, y, z));
 
@@ -183,35 +797,93 @@ protected:
         auto it = s_blockTypes.find(type);
         if (it != s_blockTypes.end()) {
             SolidBlock *block = it->second;
+            if (block->isInstanced()) {
+                addInstance(x + CHUNK_WIDTH * (y * CHUNK_WIDTH + z), type);
+                return;
+            }
+
             uint8_t mask = 0;
-            if (!isSolidBlock(unpackType(GetBlockAtPosition(x, y + 1, z)))) {
+            if (isFaceVisible(type, unpackType(GetBlockAtPosition(x, y + 1, z)))) {
                 mask |= SolidBlock::Top;
             }
-            if (!isSolidBlock(unpackType(GetBlockAtPosition(x, y - 1, z)))) {
+            if (isFaceVisible(type, unpackType(GetBlockAtPosition(x, y - 1, z)))) {
                 mask |= SolidBlock::Bottom;
             }
-            if (!isSolidBlock(unpackType(GetBlockAtPosition(x - 1, y, z)))) {
+            if (isFaceVisible(type, unpackType(GetBlockAtPosition(x - 1, y, z)))) {
                 mask |= SolidBlock::Left;
             }
-            if (!isSolidBlock(unpackType(GetBlockAtPosition(x + 1, y, z)))) {
+            if (isFaceVisible(type, unpackType(GetBlockAtPosition(x + 1, y, z)))) {
                 mask |= SolidBlock::Right;
             }
-            if (!isSolidBlock(unpackType(GetBlockAtPosition(x, y, z - 1)))) {
+            if (isFaceVisible(type, unpackType(GetBlockAtPosition(x, y, z - 1)))) {
                 mask |= SolidBlock::Back;
             }
-            if (!isSolidBlock(unpackType(GetBlockAtPosition(x, y, z + 1)))) {
+            if (isFaceVisible(type, unpackType(GetBlockAtPosition(x, y, z + 1)))) {
                 mask |= SolidBlock::Front;
             }
 
             if(mask > 0) {
-                block->buildGeometry(block->isCollidable() ? *m_solidMesh : *m_vegetationMesh, type, mask, x, y, z);
+                bool translucent = (SolidBlock::opacity(type) == SolidBlock::Translucent);
+                block->buildGeometry(translucent ? *m_translucentMesh : *m_solidMesh, type, mask, x, y, z);
             }
         }
 
     }
 
+    // Every face of the fully opaque section surrounded by the opaque sections is hidden
+    bool isSectionBuried(int32_t s) const {
+        if (!m_chunkData->isSectionOpaque(s) || !m_chunkData->isSectionOpaque(s - 1) || !m_chunkData->isSectionOpaque(s + 1)) {
+            return false;
+        }
+
+        const int32_t offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+        for (auto &it : offsets) {
+            auto neighbour = s_chunks.find(ChunkData::posToIndex(m_chunkData->x + it[0], m_chunkData->y + it[1]));
+            if (neighbour != s_chunks.end() && !neighbour->second.isSectionOpaque(s)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void addInstance(uint32_t index, BlockType type) {
+        m_instanceSlots[index] = m_instances.size();
+        m_instances.push_back({index, type});
+    }
+
+    void removeInstance(uint32_t index) {
+        auto it = m_instanceSlots.find(index);
+        if (it == m_instanceSlots.end()) {
+            return;
+        }
+
+        // Move the last instance into the freed slot
+        uint32_t slot = it->second;
+        m_instanceSlots.erase(it);
+        if (slot != m_instances.size() - 1) {
+            m_instances[slot] = m_instances.back();
+            m_instanceSlots[m_instances[slot].index] = slot;
+        }
+        m_instances.pop_back();
+    }
+
+    inline bool isInstanceOrAir(BlockType type) {
+        if (type == BlockType::Air) {
+            return true;
+        }
+        auto it = s_blockTypes.find(type);
+        return (it != s_blockTypes.end() && it->second->isInstanced());
+    }
+
     inline bool isSolidBlock(BlockType type) {
-        return (type != BlockType::Air && type != BlockType::Leaves && type != BlockType::TallGrass && type != BlockType::Sapling);
+        return ChunkData::isOpaque(type);
+    }
+
+    inline bool isFaceVisible(BlockType type, BlockType neighbour) {
+        if (type == neighbour) {
+            return false;
+        }
+        return !isSolidBlock(neighbour);
     }
 
     uint32_t GetBlockAtPosition(int32_t x, int32_t y, int32_t z) {
@@ -223,6 +895,9 @@ protected:
         if(y < 0) {
             return (uint32_t)BlockType::Dirt;
         }
+        if(y >= CHUNK_HEIGHT) {
+            return (uint32_t)BlockType::Air;
+        }
 
         int32_t adjustX = m_chunkData->x;
         if (x < 0) {
@@ -250,3 +925,67 @@ protected:
         return (uint32_t)BlockType::Dirt;
     }
 };
+
+// Requests rebuild of all the sections touching the box, one block around it is included for the neighbour faces
+static void markBoxDirty(int32_t minX, int32_t minY, int32_t minZ, int32_t maxX, int32_t maxY, int32_t maxZ) {
+    minX = MAX(minX - 1, 0);
+    minZ = MAX(minZ - 1, 0);
+    minY = MAX(minY - 1, 0);
+    maxY = MIN(maxY + 1, CHUNK_HEIGHT - 1);
+    if(maxY < minY || maxX + 1 < minX || maxZ + 1 < minZ) {
+        return;
+    }
+
+    uint32_t mask = 0;
+    for(int32_t s = minY / SECTION_HEIGHT; s <= maxY / SECTION_HEIGHT; s++) {
+        mask |= (1U << s);
+    }
+
+    for(int32_t x = minX / CHUNK_WIDTH; x <= (maxX + 1) / CHUNK_WIDTH; x++) {
+        for(int32_t y = minZ / CHUNK_WIDTH; y <= (maxZ + 1) / CHUNK_WIDTH; y++) {
+            uint64_t key = ChunkData::posToIndex(x, y);
+            if(s_chunks.find(key) != s_chunks.end()) {
+                s_dirtySections[key] |= mask;
+            }
+        }
+    }
+}
+
+// Corner blocks also dirty the diagonal chunk
+static void markBlockDirty(int32_t x, int32_t y, int32_t z) {
+    markBoxDirty(x, y, z, x, y, z);
+}
+
+// Chunks meshed while this one was missing have closed borders towards it, those are remeshed
+static void markChunkLoaded(int32_t chunkX, int32_t chunkY) {
+    const int32_t offsets[4][3] = {{1, 0, ChunkRenderer::West}, {-1, 0, ChunkRenderer::East}, {0, 1, ChunkRenderer::North}, {0, -1, ChunkRenderer::South}};
+
+    for(auto &it : offsets) {
+        auto neighbour = s_chunks.find(ChunkData::posToIndex(chunkX + it[0], chunkY + it[1]));
+        if(neighbour != s_chunks.end() && neighbour->second.renderer && (neighbour->second.renderer->missingNeighbours() & it[2])) {
+            s_dirtySections[neighbour->first] |= SECTIONS_MASK;
+        }
+    }
+}
+
+// Every chunk touched since the last call is rebuilt once, chunks without a renderer keep their sections pending.
+// Chunks left after the deadline wait for the next call, at least one chunk is rebuilt each time.
+static void rebuildDirtyChunks(std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) {
+    bool rebuilt = false;
+    for(auto it = s_dirtySections.begin(); it != s_dirtySections.end(); ) {
+        auto chunk = s_chunks.find(it->first);
+        if(chunk == s_chunks.end()) {
+            it = s_dirtySections.erase(it);
+        } else if(chunk->second.renderer) {
+            if(rebuilt && std::chrono::steady_clock::now() > deadline) {
+                break;
+            }
+            uint32_t mask = it->second;
+            it = s_dirtySections.erase(it);
+            chunk->second.renderer->RebuildSections(mask);
+            rebuilt = true;
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,447 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <unordered_set>
+
+#include "Blocks/SolidBlock.cpp"
+
+#define JOURNAL_MAGIC 0x324a4d54 // "TMJ2"
+#define REGION_SIZE 4
+
+struct JournalRecord {
+    int32_t chunkX;
+    int32_t chunkY;
+    uint32_t index;
+    uint32_t oldBlock;
+    uint32_t newBlock;
+    uint64_t tick;
+};
+
+// Incremental decoder of the journal byte stream, bytes may come in any portions
+class JournalReader {
+    std::vector<uint8_t> m_buffer;
+    size_t m_position = 0;
+    uint64_t m_offset = 0;
+    uint32_t m_epoch = 0;
+    uint32_t m_restarts = 0;
+    bool m_header = false;
+
+public:
+    void feed(const uint8_t *data, size_t size) {
+        m_buffer.insert(m_buffer.end(), data, data + size);
+        m_offset += size;
+    }
+
+    bool next(JournalRecord &record) {
+        size_t position = m_position;
+        if(!m_header) {
+            uint32_t magic = 0;
+            if(!readFixed(position, magic, 4)) {
+                return false;
+            }
+            if(magic != JOURNAL_MAGIC) {
+                m_buffer.clear();
+                m_position = 0;
+                return false;
+            }
+            if(!readFixed(position, m_epoch, 4)) {
+                return false;
+            }
+            m_header = true;
+            m_position = position;
+        }
+
+        uint64_t x, y, index, oldBlock, newBlock, tick;
+        if(!readVarint(position, x) || !readVarint(position, y) || !readFixed(position, index, 2) ||
+           !readVarint(position, oldBlock) || !readVarint(position, newBlock) || !readVarint(position, tick)) {
+            return false;
+        }
+
+        record.chunkX = unzigzag(x);
+        record.chunkY = unzigzag(y);
+        record.index = index;
+        record.oldBlock = oldBlock;
+        record.newBlock = newBlock;
+        record.tick = tick;
+
+        m_position = position;
+        if(m_position > 4096 && m_position * 2 > m_buffer.size()) {
+            m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_position);
+            m_position = 0;
+        }
+        return true;
+    }
+
+    // Reads the bytes appended to the file since the last call, used to follow the journal of another process
+    bool poll(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        if(!file.is_open()) {
+            return false;
+        }
+
+        file.seekg(0, std::ios::end);
+        uint64_t size = file.tellg();
+        if(size < m_offset || (m_header && readEpoch(file) != m_epoch)) {
+            // Journal was compacted, start over. It could have grown past the read position again, the epoch tells
+            reset();
+            m_restarts++;
+        }
+        if(size == m_offset) {
+            return false;
+        }
+
+        std::vector<uint8_t> data(size - m_offset);
+        file.seekg(m_offset);
+        file.read(reinterpret_cast<char *>(data.data()), data.size());
+        feed(data.data(), data.size());
+        return true;
+    }
+
+    void reset() {
+        m_buffer.clear();
+        m_position = 0;
+        m_offset = 0;
+        m_epoch = 0;
+        m_header = false;
+    }
+
+    // Number of times the followed journal was found compacted, the records missed meanwhile are only in the regions
+    uint32_t restarts() const {
+        return m_restarts;
+    }
+
+    static int32_t unzigzag(uint64_t value) {
+        return int32_t((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+protected:
+    static uint32_t readEpoch(std::ifstream &file) {
+        uint8_t data[4] = {};
+        file.seekg(4);
+        file.read(reinterpret_cast<char *>(data), sizeof(data));
+        return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+    }
+
+    template<typename T>
+    bool readFixed(size_t &position, T &value, uint32_t bytes) {
+        if(position + bytes > m_buffer.size()) {
+            return false;
+        }
+        value = 0;
+        for(uint32_t i = 0; i < bytes; i++) {
+            value |= T(m_buffer[position++]) << (i * 8);
+        }
+        return true;
+    }
+
+    bool readVarint(size_t &position, uint64_t &value) {
+        value = 0;
+        for(uint32_t shift = 0; shift < 64; shift += 7) {
+            if(position >= m_buffer.size()) {
+                return false;
+            }
+            uint8_t byte = m_buffer[position++];
+            value |= uint64_t(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+};
+
+// Append-only log of the block changes made during the game
+class EditJournal {
+    std::vector<uint8_t> m_buffer;
+    std::ofstream m_file;
+    std::string m_directory;
+
+    uint64_t m_tick = 0;
+    uint64_t m_size = 0;
+    uint64_t m_records = 0;
+
+    bool m_recording = false;
+
+public:
+    ~EditJournal() {
+        flush();
+    }
+
+    // A replica opens the journal of another process only to find its files, nothing is written
+    void open(const std::string &directory, bool writable = true) {
+        close();
+
+        m_directory = directory;
+        std::filesystem::create_directories(m_directory);
+
+        std::error_code error;
+        m_size = std::filesystem::file_size(journalPath(), error);
+        if(error) {
+            m_size = 0;
+        }
+        if(!writable) {
+            return;
+        }
+
+        // Journals of the older format can't be continued, they are started over
+        if(m_size != 0 && readMagic() != JOURNAL_MAGIC) {
+            m_size = 0;
+        }
+        m_file.open(journalPath(), std::ios::binary | (m_size == 0 ? std::ios::trunc : std::ios::app));
+        if(m_size == 0) {
+            writeHeader();
+        }
+    }
+
+    void close() {
+        flush();
+        if(m_file.is_open()) {
+            m_file.close();
+        }
+        m_recording = false;
+    }
+
+    bool isRecording() const {
+        return m_recording;
+    }
+
+    void setRecording(bool recording) {
+        m_recording = recording && m_file.is_open();
+    }
+
+    void setTick(uint64_t tick) {
+        m_tick = tick;
+    }
+
+    // Called for every block write, only encodes into the memory buffer
+    inline void append(int32_t chunkX, int32_t chunkY, uint32_t index, uint32_t oldBlock, uint32_t newBlock) {
+        if(!m_recording || oldBlock == newBlock) {
+            return;
+        }
+
+        writeVarint(zigzag(chunkX));
+        writeVarint(zigzag(chunkY));
+        m_buffer.push_back(index & 0xff);
+        m_buffer.push_back((index >> 8) & 0xff);
+        writeVarint(oldBlock);
+        writeVarint(newBlock);
+        writeVarint(m_tick);
+
+        m_records++;
+    }
+
+    void flush() {
+        if(m_buffer.empty() || !m_file.is_open()) {
+            return;
+        }
+
+        m_file.write(reinterpret_cast<const char *>(m_buffer.data()), m_buffer.size());
+        m_file.flush();
+
+        m_size += m_buffer.size();
+        m_buffer.clear();
+    }
+
+    void replay(const std::function<void(const JournalRecord &)> &apply) {
+        std::ifstream file(journalPath(), std::ios::binary);
+        if(!file.is_open()) {
+            return;
+        }
+
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        JournalReader reader;
+        reader.feed(data.data(), data.size());
+
+        JournalRecord record;
+        while(reader.next(record)) {
+            apply(record);
+        }
+    }
+
+    // Folds the journal into the region snapshots of all the chunks it has touched and starts an empty journal
+    void compact(const std::function<const std::vector<uint32_t> *(int32_t, int32_t)> &chunk) {
+        flush();
+
+        std::unordered_set<uint64_t> regions;
+        replay([&regions](const JournalRecord &record) {
+            regions.insert(regionKey(regionCoord(record.chunkX), regionCoord(record.chunkY)));
+        });
+
+        for(auto key : regions) {
+            int32_t regionX = int32_t(key & 0xffffffff);
+            int32_t regionY = int32_t(key >> 32);
+
+            std::vector<uint8_t> data;
+            for(int32_t x = 0; x < REGION_SIZE; x++) {
+                for(int32_t y = 0; y < REGION_SIZE; y++) {
+                    int32_t chunkX = regionX * REGION_SIZE + x;
+                    int32_t chunkY = regionY * REGION_SIZE + y;
+                    const std::vector<uint32_t> *blocks = chunk(chunkX, chunkY);
+                    if(blocks) {
+                        encodeChunk(data, chunkX, chunkY, *blocks);
+                    }
+                }
+            }
+
+            // A crash while writing must not destroy the previous snapshot, the journal is kept if anything failed
+            std::string path = regionPath(regionX, regionY);
+            std::string temp = path + ".tmp";
+            {
+                std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+                file.write(reinterpret_cast<const char *>(data.data()), data.size());
+                if(!file.good()) {
+                    return;
+                }
+            }
+
+            std::error_code error;
+            std::filesystem::rename(temp, path, error);
+            if(error) {
+                return;
+            }
+        }
+
+        m_file.close();
+        m_file.open(journalPath(), std::ios::binary | std::ios::trunc);
+        m_size = 0;
+        writeHeader();
+    }
+
+    // Restores the chunks saved by compaction, must be called before the replay
+    void loadRegions(const std::function<std::vector<uint32_t> *(int32_t, int32_t)> &chunk) {
+        std::error_code error;
+        for(auto &entry : std::filesystem::directory_iterator(m_directory, error)) {
+            if(entry.path().extension() != ".region") {
+                continue;
+            }
+
+            std::ifstream file(entry.path(), std::ios::binary);
+            std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+            size_t position = 0;
+            while(position < data.size()) {
+                int32_t chunkX = JournalReader::unzigzag(readVarint(data, position));
+                int32_t chunkY = JournalReader::unzigzag(readVarint(data, position));
+
+                decodeRuns(data, position, chunk(chunkX, chunkY));
+            }
+        }
+    }
+
+    uint64_t size() const {
+        return m_size + m_buffer.size();
+    }
+
+    uint64_t records() const {
+        return m_records;
+    }
+
+    std::string journalPath() const {
+        return m_directory + "/world.journal";
+    }
+
+    std::string directory() const {
+        return m_directory;
+    }
+
+    static uint64_t zigzag(int32_t value) {
+        return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+    }
+
+    static void writeVarint(std::vector<uint8_t> &data, uint64_t value) {
+        while(value >= 0x80) {
+            data.push_back(uint8_t(value) | 0x80);
+            value >>= 7;
+        }
+        data.push_back(uint8_t(value));
+    }
+
+    static uint64_t readVarint(const std::vector<uint8_t> &data, size_t &position) {
+        uint64_t value = 0;
+        for(uint32_t shift = 0; shift < 64 && position < data.size(); shift += 7) {
+            uint8_t byte = data[position++];
+            value |= uint64_t(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    // Blocks are stored as runs of the same value
+    static void encodeRuns(std::vector<uint8_t> &data, const std::vector<uint32_t> &blocks) {
+        writeVarint(data, blocks.size());
+
+        size_t i = 0;
+        while(i < blocks.size()) {
+            uint32_t value = blocks[i];
+            uint32_t count = 1;
+            while(i + count < blocks.size() && blocks[i + count] == value) {
+                count++;
+            }
+            writeVarint(data, count);
+            writeVarint(data, value);
+            i += count;
+        }
+    }
+
+    static void decodeRuns(const std::vector<uint8_t> &data, size_t &position, std::vector<uint32_t> *blocks) {
+        size_t i = 0;
+        size_t total = readVarint(data, position);
+        while(i < total && position < data.size()) {
+            uint32_t count = readVarint(data, position);
+            uint32_t value = readVarint(data, position);
+            for(uint32_t c = 0; c < count && i < total; c++, i++) {
+                if(blocks && i < blocks->size()) {
+                    (*blocks)[i] = value;
+                }
+            }
+        }
+    }
+
+protected:
+    std::string regionPath(int32_t x, int32_t y) const {
+        return m_directory + "/" + std::to_string(x) + "." + std::to_string(y) + ".region";
+    }
+
+    static int32_t regionCoord(int32_t chunk) {
+        return chunk >= 0 ? chunk / REGION_SIZE : (chunk - REGION_SIZE + 1) / REGION_SIZE;
+    }
+
+    static uint64_t regionKey(int32_t x, int32_t y) {
+        return uint64_t(uint32_t(x)) | (uint64_t(uint32_t(y)) << 32);
+    }
+
+    uint32_t readMagic() const {
+        uint32_t magic = 0;
+        std::ifstream file(journalPath(), std::ios::binary);
+        file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+        return magic;
+    }
+
+    // Every new journal gets another epoch so the followers notice the compaction
+    void writeHeader() {
+        uint32_t header[2] = {JOURNAL_MAGIC, uint32_t(std::chrono::system_clock::now().time_since_epoch().count())};
+        m_file.write(reinterpret_cast<const char *>(header), sizeof(header));
+        m_file.flush();
+        m_size = sizeof(header);
+    }
+
+    inline void writeVarint(uint64_t value) {
+        writeVarint(m_buffer, value);
+    }
+
+    static void encodeChunk(std::vector<uint8_t> &data, int32_t chunkX, int32_t chunkY, const std::vector<uint32_t> &blocks) {
+        writeVarint(data, zigzag(chunkX));
+        writeVarint(data, zigzag(chunkY));
+        encodeRuns(data, blocks);
+    }
+
+};
+
+static EditJournal s_journal;
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <chrono>
+#include <random>
+
+#include "FluidSimulator.cpp"
+#include "ScratchWorld.cpp"
+
+#define FLUID_CHECK_SIZE 7
+#define FLUID_CHECK_TICKS 4000
+
+// Floods a headless 7x7 chunk world from many sources and measures how the fluid ticks keep to their budget
+class FluidCheck {
+public:
+    static bool run(uint32_t seed, float tickTimeBudget) {
+        std::minstd_rand random(seed + 1);
+
+        ScratchWorld world;
+        FluidSimulator fluids;
+        fluids.setTickTimeBudget(tickTimeBudget);
+
+        createWorld(random, fluids);
+
+        uint32_t ticks = 0;
+        uint32_t sections = 0;
+        float total = 0.0f;
+        float longest = 0.0f;
+        while(fluids.activeCells() > 0 && ticks < FLUID_CHECK_TICKS) {
+            auto start = std::chrono::steady_clock::now();
+            fluids.tick();
+            std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            total += elapsed.count();
+            longest = MAX(longest, elapsed.count());
+            sections += ScratchWorld::takeDirtySections();
+            ticks++;
+        }
+        uint64_t processed = fluids.processedCells();
+
+        // Waking up every fluid cell of the settled world must change nothing, otherwise some update was lost
+        std::vector<std::vector<uint32_t>> settled;
+        uint32_t flooded = 0;
+        ScratchWorld::forEachChunk(FLUID_CHECK_SIZE, [&](ChunkData &data) {
+            settled.push_back(data.blocks);
+            for(size_t i = 0; i < data.blocks.size(); i++) {
+                if(FluidBlock::isFluid(ChunkRenderer::unpackType(data.blocks[i]))) {
+                    int32_t x = i % CHUNK_WIDTH;
+                    int32_t z = (i / CHUNK_WIDTH) % CHUNK_WIDTH;
+                    int32_t y = i / (CHUNK_WIDTH * CHUNK_WIDTH);
+                    fluids.schedule(data.x * CHUNK_WIDTH + x, y, data.y * CHUNK_WIDTH + z);
+                    flooded++;
+                }
+            }
+        });
+        for(uint32_t i = 0; i < FLUID_CHECK_TICKS && fluids.activeCells() > 0; i++) {
+            fluids.tick();
+        }
+        ScratchWorld::takeDirtySections();
+
+        uint32_t changed = 0;
+        size_t c = 0;
+        ScratchWorld::forEachChunk(FLUID_CHECK_SIZE, [&](ChunkData &data) {
+            changed += (data.blocks != settled[c++]) ? 1 : 0;
+        });
+
+        aInfo() << "Fluid check:" << int(ticks) << "ticks," << int(processed) << "cell updates," << int(flooded) << "fluid blocks," << int(changed) << "unsettled chunks";
+        aInfo() << "Fluid check:" << total / MAX(ticks, 1U) << "ms per tick, longest" << longest << "ms with budget" << tickTimeBudget << "ms," << float(sections) / MAX(ticks, 1U) << "sections remeshed per tick";
+
+        if(ticks >= FLUID_CHECK_TICKS) {
+            aError() << "Fluid check failed: the flood didn't settle in" << FLUID_CHECK_TICKS << "ticks";
+        }
+        if(changed > 0) {
+            aError() << "Fluid check failed:" << int(changed) << "chunks changed after settling, some updates were lost";
+        }
+        return ticks < FLUID_CHECK_TICKS && changed == 0;
+    }
+
+protected:
+    // Terraces of 4x4 columns make the fluid fall and spread over the chunk borders
+    static void createWorld(std::minstd_rand &random, FluidSimulator &fluids) {
+        const int32_t cells = FLUID_CHECK_SIZE * CHUNK_WIDTH / 4;
+        std::vector<int32_t> terraces(cells * cells);
+        for(auto &it : terraces) {
+            it = 8 + random() % 12;
+        }
+
+        for(int32_t i = 0; i < FLUID_CHECK_SIZE; i++) {
+            for(int32_t j = 0; j < FLUID_CHECK_SIZE; j++) {
+                ChunkData &data = ScratchWorld::createChunk(i, j);
+                for(int32_t x = 0; x < CHUNK_WIDTH; x++) {
+                    for(int32_t z = 0; z < CHUNK_WIDTH; z++) {
+                        int32_t height = terraces[(i * CHUNK_WIDTH + x) / 4 + ((j * CHUNK_WIDTH + z) / 4) * cells];
+                        for(int32_t y = 0; y < height; y++) {
+                            data.blocks[ChunkData::blockIndex(x, y, z)] = (uint32_t)(y == 0 ? BlockType::Bedrock : BlockType::Stone);
+                        }
+                    }
+                }
+                data.recount();
+            }
+        }
+
+        // Sources on every fourth terrace, some of them are lava
+        for(int32_t c = 0; c < cells * cells; c++) {
+            if(random() % 4 != 0) {
+                continue;
+            }
+            int32_t x = CHECK_ORIGIN * CHUNK_WIDTH + (c % cells) * 4 + random() % 4;
+            int32_t z = CHECK_ORIGIN * CHUNK_WIDTH + (c / cells) * 4 + random() % 4;
+            int32_t y = terraces[c];
+
+            uint32_t block = 0;
+            ChunkRenderer::packType(block, (random() % 16 == 0) ? BlockType::Lava : BlockType::Water);
+
+            ChunkData &data = s_chunks[ChunkData::posToIndex(x / CHUNK_WIDTH, z / CHUNK_WIDTH)];
+            data.write(ChunkData::blockIndex(x % CHUNK_WIDTH, y, z % CHUNK_WIDTH), block);
+            fluids.schedule(x, y, z);
+        }
+        ScratchWorld::takeDirtySections();
+    }
+
+};
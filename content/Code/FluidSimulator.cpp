@@ -0,0 +1,265 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <unordered_set>
+
+#include "ChunkRenderer.cpp"
+
+#define WATER_SPREAD 7
+#define LAVA_SPREAD 3
+
+class FluidSimulator {
+    std::deque<uint64_t> m_active;
+    std::deque<uint64_t> m_pending;
+    std::unordered_set<uint64_t> m_scheduled;
+
+    uint32_t m_tickPeriod = 5;
+    uint32_t m_worldTicks = 0;
+    float m_tickTimeBudget = 2.0f; // milliseconds per fluid tick
+    uint32_t m_tickBudget = 4096;
+    uint32_t m_lavaRate = 3;
+    uint32_t m_tick = 0;
+    uint64_t m_processed = 0;
+
+public:
+    static uint64_t packPosition(int32_t x, int32_t y, int32_t z) {
+        return uint64_t(x & 0xffffff) | (uint64_t(z & 0xffffff) << 24) | (uint64_t(y & 0xffff) << 48);
+    }
+
+    static void unpackPosition(uint64_t key, int32_t &x, int32_t &y, int32_t &z) {
+        x = key & 0xffffff;
+        z = (key >> 24) & 0xffffff;
+        y = (key >> 48) & 0xffff;
+    }
+
+    void clear() {
+        m_active.clear();
+        m_pending.clear();
+        m_scheduled.clear();
+        m_worldTicks = 0;
+        m_tick = 0;
+        m_processed = 0;
+    }
+
+    // Wakes up the fluid cells around the changed block
+    void notifyChange(int32_t x, int32_t y, int32_t z) {
+        schedule(x, y, z);
+        schedule(x, y + 1, z);
+        schedule(x, y - 1, z);
+        schedule(x - 1, y, z);
+        schedule(x + 1, y, z);
+        schedule(x, y, z - 1);
+        schedule(x, y, z + 1);
+    }
+
+    void schedule(int32_t x, int32_t y, int32_t z) {
+        uint32_t *block = blockAt(x, y, z);
+        if(block == nullptr || !FluidBlock::isFluid(ChunkRenderer::unpackType(*block))) {
+            return;
+        }
+
+        uint64_t key = packPosition(x, y, z);
+        if(m_scheduled.insert(key).second) {
+            m_pending.push_back(key);
+        }
+    }
+
+    // Called once per world tick, the fluids flow every few world ticks
+    void update() {
+        if(m_active.empty() && m_pending.empty()) {
+            m_worldTicks = 0;
+            return;
+        }
+
+        if(++m_worldTicks < m_tickPeriod) {
+            return;
+        }
+        m_worldTicks = 0;
+
+        tick();
+    }
+
+    void tick() {
+        auto start = std::chrono::steady_clock::now();
+
+        // Cells scheduled during the previous tick become active now, cells which didn't fit into budget stay in front
+        for(auto key : m_pending) {
+            m_active.push_back(key);
+        }
+        m_pending.clear();
+
+        bool lavaTick = (m_tick % m_lavaRate) == 0;
+        m_tick++;
+
+        uint32_t processed = 0;
+        std::deque<uint64_t> deferred;
+        while(!m_active.empty() && processed < m_tickBudget) {
+            uint64_t key = m_active.front();
+            m_active.pop_front();
+
+            int32_t x, y, z;
+            unpackPosition(key, x, y, z);
+
+            uint32_t *block = blockAt(x, y, z);
+            if(block == nullptr) {
+                m_scheduled.erase(key);
+                continue;
+            }
+
+            BlockType type = ChunkRenderer::unpackType(*block);
+            if(FluidBlock::isLava(type) && !lavaTick) {
+                deferred.push_back(key);
+                continue;
+            }
+
+            m_scheduled.erase(key);
+            updateCell(x, y, z);
+            processed++;
+
+            if((processed & 63) == 0) {
+                std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                if(elapsed.count() > m_tickTimeBudget) {
+                    break;
+                }
+            }
+        }
+
+        for(auto key : deferred) {
+            m_active.push_back(key);
+        }
+        m_processed += processed;
+    }
+
+    size_t activeCells() const {
+        return m_active.size() + m_pending.size();
+    }
+
+    uint64_t processedCells() const {
+        return m_processed;
+    }
+
+    uint32_t tickPeriod() const {
+        return m_tickPeriod;
+    }
+
+    void setTickPeriod(uint32_t period) {
+        m_tickPeriod = MAX(period, 1U);
+    }
+
+    float tickTimeBudget() const {
+        return m_tickTimeBudget;
+    }
+
+    void setTickTimeBudget(float budget) {
+        m_tickTimeBudget = budget;
+    }
+
+    uint32_t tickBudget() const {
+        return m_tickBudget;
+    }
+
+    void setTickBudget(uint32_t budget) {
+        m_tickBudget = MAX(budget, 1U);
+    }
+
+protected:
+    void updateCell(int32_t x, int32_t y, int32_t z) {
+        uint32_t *block = blockAt(x, y, z);
+        BlockType type = ChunkRenderer::unpackType(*block);
+        if(!FluidBlock::isFluid(type)) {
+            return;
+        }
+
+        bool lava = FluidBlock::isLava(type);
+        BlockType flowing = lava ? BlockType::FlowingLava : BlockType::FlowingWater;
+        uint8_t spread = lava ? LAVA_SPREAD : WATER_SPREAD;
+        uint8_t level = ChunkRenderer::unpackLevel(*block);
+
+        if(!FluidBlock::isSource(type)) {
+            // Flowing fluid must be fed by a neighbour, otherwise it dries up
+            uint8_t expected = spread + 1;
+            uint32_t *above = blockAt(x, y + 1, z);
+            if(above && FluidBlock::isSameFluid(type, ChunkRenderer::unpackType(*above))) {
+                expected = 1;
+            } else {
+                const int32_t offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+                for(auto &it : offsets) {
+                    uint32_t *neighbour = blockAt(x + it[0], y, z + it[1]);
+                    if(neighbour && FluidBlock::isSameFluid(type, ChunkRenderer::unpackType(*neighbour))) {
+                        uint8_t l = FluidBlock::isSource(ChunkRenderer::unpackType(*neighbour)) ? 0 : ChunkRenderer::unpackLevel(*neighbour);
+                        expected = MIN(expected, uint8_t(l + 1));
+                    }
+                }
+            }
+
+            if(expected > spread) {
+                setBlock(x, y, z, BlockType::Air, 0);
+                return;
+            }
+            if(expected != level) {
+                level = expected;
+                setBlock(x, y, z, flowing, level);
+            }
+        }
+
+        // Falling has priority over spreading
+        uint32_t *below = blockAt(x, y - 1, z);
+        if(below) {
+            BlockType belowType = ChunkRenderer::unpackType(*below);
+            if(belowType == BlockType::Air || belowType == BlockType::TallGrass) {
+                setBlock(x, y - 1, z, flowing, 1);
+                return;
+            }
+            if(FluidBlock::isFluid(belowType) && !FluidBlock::isSameFluid(type, belowType)) {
+                setBlock(x, y - 1, z, FluidBlock::isSource(belowType) ? BlockType::Stone : BlockType::Cobblestone, 0);
+                return;
+            }
+            if(FluidBlock::isSameFluid(type, belowType)) {
+                return;
+            }
+        }
+
+        uint8_t next = FluidBlock::isSource(type) ? 1 : level + 1;
+        if(next > spread) {
+            return;
+        }
+
+        const int32_t offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+        for(auto &it : offsets) {
+            int32_t nx = x + it[0];
+            int32_t nz = z + it[1];
+            uint32_t *neighbour = blockAt(nx, y, nz);
+            if(neighbour == nullptr) {
+                continue;
+            }
+
+            BlockType neighbourType = ChunkRenderer::unpackType(*neighbour);
+            if(neighbourType == BlockType::Air || neighbourType == BlockType::TallGrass) {
+                setBlock(nx, y, nz, flowing, next);
+            } else if(neighbourType == flowing && ChunkRenderer::unpackLevel(*neighbour) > next) {
+                setBlock(nx, y, nz, flowing, next);
+            } else if(FluidBlock::isFluid(neighbourType) && !FluidBlock::isSameFluid(type, neighbourType)) {
+                setBlock(nx, y, nz, FluidBlock::isSource(neighbourType) ? BlockType::Stone : BlockType::Cobblestone, 0);
+            }
+        }
+    }
+
+    void setBlock(int32_t x, int32_t y, int32_t z, BlockType type, uint8_t level) {
+        auto it = s_chunks.find(ChunkData::posToIndex(x / CHUNK_WIDTH, z / CHUNK_WIDTH));
+        if(it == s_chunks.end()) {
+            return;
+        }
+
+        uint32_t block = 0;
+        ChunkRenderer::packType(block, type);
+        ChunkRenderer::packLevel(block, level);
+        it->second.write(ChunkData::blockIndex(x % CHUNK_WIDTH, y, z % CHUNK_WIDTH), block);
+
+        notifyChange(x, y, z);
+        markBlockDirty(x, y, z);
+    }
+
+};
+
+static FluidSimulator s_fluids;
@@ -10,6 +10,7 @@
 #include <log.h>
 
 #include "WorldManager.cpp"
+#include "VoxelPhysics.cpp"
 
 class FpsController : public NativeBehaviour {
     A_OBJECT(FpsController, NativeBehaviour, Components)
@@ -17,7 +18,8 @@ class FpsController : public NativeBehaviour {
     A_PROPERTIES(
         A_PROPERTY(PlayerInput *, playerInput, FpsController::playerInput, FpsController::setPlayerInput),
         A_PROPERTY(CharacterController *, characterController, FpsController::characterController, FpsController::setCharacterController),
-        A_PROPERTY(Transform *, targetCube, FpsController::targetCube, FpsController::setTargetCube)
+        A_PROPERTY(Transform *, targetCube, FpsController::targetCube, FpsController::setTargetCube),
+        A_PROPERTY(bool, voxelPhysics, FpsController::voxelPhysics, FpsController::setVoxelPhysics)
     )
     
     PlayerInput *m_playerInput = nullptr;
@@ -28,6 +30,13 @@ class FpsController : public NativeBehaviour {
     float jumpSpeed = 5.0f;
     float gravity = 20.0f;
     Vector3 m_moveDirection;
+
+    VoxelBody m_body;
+    Vector3 m_velocity;
+    Vector3 m_previousPosition;
+    float m_stepAccumulator = 0.0f;
+    bool m_voxelPhysics = false;
+    bool m_bodyPlaced = false;
     
 public:
     // Use this to initialize behaviour
@@ -37,6 +46,14 @@ public:
         if (camera) {
             Camera::setCurrent(camera);
         }
+
+        // The body collides with the blocks directly, the physics engine has nothing to do for the player
+        if (m_voxelPhysics) {
+            if (m_characterCtrl) {
+                m_characterCtrl->setEnabled(false);
+            }
+            ChunkRenderer::setMeshColliders(false);
+        }
     }
 
     // Will be called each frame. Use this to write your game logic
@@ -52,15 +69,35 @@ public:
             camera_t->setRotation(camera_t->rotation() - Vector3(-delta.y, 0.0f, 0.0f));
 
             int x, y, z;
+            int front[3];
             Ray ray = camera->castRay(0.5f, 0.5f);
-            Ray::Hit hit;
-            bool result = world()->rayCast(ray, 4.0f, &hit);
-            if (result) {
-                Vector3 pos = hit.point - hit.normal * 0.5f;
+            bool result = false;
+            if (m_voxelPhysics) {
+                int target[3];
+                result = VoxelRay::cast(ray.pos, ray.dir, 4.0f, target, front);
+                if (result) {
+                    x = target[0];
+                    y = target[1];
+                    z = target[2];
+                }
+            } else {
+                Ray::Hit hit;
+                result = world()->rayCast(ray, 4.0f, &hit);
+                if (result) {
+                    Vector3 pos = hit.point - hit.normal * 0.5f;
 
-                x = floor(pos.x);
-                y = floor(pos.y);
-                z = floor(pos.z);
+                    x = floor(pos.x);
+                    y = floor(pos.y);
+                    z = floor(pos.z);
+
+                    pos = hit.point + hit.normal * 0.5f;
+                    front[0] = floor(pos.x);
+                    front[1] = floor(pos.y);
+                    front[2] = floor(pos.z);
+                }
+            }
+
+            if (result) {
                 if(m_targetCube) {
                     m_targetCube->actor()->setEnabled(true);
                     m_targetCube->setPosition(Vector3(x + 0.5f, y + 0.5f, z + 0.5f));
@@ -72,16 +109,38 @@ public:
             }
 
             if (result) {
+                // Edits are applied by the next world tick
                 if(Input::isMouseButtonDown(Input::MOUSE_LEFT)) {
-                    WorldManager::changeBlock(x, y, z, BlockType::Air);
+                    WorldAccess::queueEdit(x, y, z, BlockType::Air);
                 } else if(Input::isMouseButtonDown(Input::MOUSE_RIGHT)) {
-                    Vector3 pos = hit.point + hit.normal * 0.5f;
-
-                    WorldManager::changeBlock(floor(pos.x), floor(pos.y), floor(pos.z), BlockType::Dirt);
+                    WorldAccess::queueEdit(front[0], front[1], front[2], BlockType::Dirt);
+                } else if(Input::isMouseButtonDown(Input::MOUSE_MIDDLE)) {
+                    // Water source, the fluid simulation spreads it from there
+                    WorldAccess::queueEdit(front[0], front[1], front[2], BlockType::Water);
                 }
             }
 
-            if(m_playerInput && m_characterCtrl) {
+            if(m_playerInput && m_voxelPhysics) {
+                if(!m_bodyPlaced) {
+                    m_body.setPosition(t->position());
+                    m_previousPosition = t->position();
+                    m_stepAccumulator = 0.0f;
+                    m_bodyPlaced = true;
+                }
+
+                // The body steps at the world tick rate from its own accumulator, so it doesn't matter whether
+                // WorldManager updates before or after this component and the ticks dropped by an overloaded world
+                // don't slow the player down. Only a frame longer than the catch up window loses steps.
+                float interval = s_clock.tickInterval();
+                m_stepAccumulator = MIN(m_stepAccumulator + Timer::deltaTime(), interval * SIMULATION_CATCH_UP);
+                for(; m_stepAccumulator >= interval; m_stepAccumulator -= interval) {
+                    m_previousPosition = m_body.position();
+                    moveBody(t, interval);
+                }
+
+                // The frames in between the steps only interpolate the position
+                t->setPosition(m_previousPosition + (m_body.position() - m_previousPosition) * (m_stepAccumulator / interval));
+            } else if(m_playerInput && m_characterCtrl) {
                 m_moveDirection = t->quaternion() * Vector3(m_playerInput->axis("Side") * speed,
                                                             m_moveDirection.y,
                                                             -m_playerInput->axis("Front") * speed);
@@ -101,6 +160,26 @@ public:
         }
     }
     
+    void moveBody(Transform *t, float delta) {
+        Vector3 move = t->quaternion() * Vector3(m_playerInput->axis("Side") * speed,
+                                                 0.0f,
+                                                 -m_playerInput->axis("Front") * speed);
+        m_velocity.x = move.x;
+        m_velocity.z = move.z;
+
+        // Holding jump keeps levitating as in the physics mode
+        if(m_playerInput->button("Jump")) {
+            m_velocity.y = jumpSpeed;
+        } else {
+            m_velocity.y = MAX(m_velocity.y - gravity * delta, -50.0f);
+        }
+
+        m_body.move(m_velocity * delta);
+        if((m_body.isGrounded() && m_velocity.y < 0.0f) || (m_body.hitCeiling() && m_velocity.y > 0.0f)) {
+            m_velocity.y = 0.0f;
+        }
+    }
+
     PlayerInput *playerInput() const {
         return m_playerInput;
     }
@@ -125,4 +204,12 @@ public:
         m_targetCube = target;
     }
 
+    bool voxelPhysics() const {
+        return m_voxelPhysics;
+    }
+
+    void setVoxelPhysics(bool enabled) {
+        m_voxelPhysics = enabled;
+    }
+
 };
@@ -0,0 +1,675 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <random>
+#include <cstring>
+
+#include "ScratchWorld.cpp"
+
+// Frozen copy of the original mesher, it shares no code with ChunkRenderer and the block classes.
+// The rules are the original ones, only the changes asked for on top of them are added and marked as such:
+// fluids and glass are meshed, plants are instances, leaves, glass and fluids don't hide faces,
+// faces between see-through blocks of the same type are hidden, fluids go to their own translucent buffer
+// and the blocks added since then have their atlas tiles.
+class ReferenceMesher {
+    enum Sides {
+        Top = (1 << 0),
+        Bottom = (1 << 1),
+        Left = (1 << 2),
+        Right = (1 << 3),
+        Back = (1 << 4),
+        Front = (1 << 5)
+    };
+
+public:
+    static void build(const ChunkData &data, ChunkMeshCache &result) {
+        result.solid = MeshBuffers();
+        result.translucent = MeshBuffers();
+        result.instances.clear();
+        result.sections.clear();
+
+        for (int32_t y = 0; y < CHUNK_HEIGHT; y++) {
+            for (int32_t x = 0; x < CHUNK_WIDTH; x++) {
+                for (int32_t z = 0; z < CHUNK_WIDTH; z++) {
+                    generateBlock(data, result, x, y, z);
+                }
+            }
+        }
+    }
+
+protected:
+    static void generateBlock(const ChunkData &data, ChunkMeshCache &result, int32_t x, int32_t y, int32_t z) {
+        BlockType type = BlockType(blockAt(data, x, y, z) & 0xff);
+        if (!isMeshed(type)) {
+            return;
+        }
+
+        if (type == BlockType::Sapling || type == BlockType::TallGrass) {
+            result.instances.push_back({uint32_t(x + CHUNK_WIDTH * (y * CHUNK_WIDTH + z)), type});
+            return;
+        }
+
+        uint8_t mask = 0;
+        if (isFaceVisible(type, blockAt(data, x, y + 1, z))) {
+            mask |= Top;
+        }
+        if (isFaceVisible(type, blockAt(data, x, y - 1, z))) {
+            mask |= Bottom;
+        }
+        if (isFaceVisible(type, blockAt(data, x - 1, y, z))) {
+            mask |= Left;
+        }
+        if (isFaceVisible(type, blockAt(data, x + 1, y, z))) {
+            mask |= Right;
+        }
+        if (isFaceVisible(type, blockAt(data, x, y, z - 1))) {
+            mask |= Back;
+        }
+        if (isFaceVisible(type, blockAt(data, x, y, z + 1))) {
+            mask |= Front;
+        }
+
+        if (mask > 0) {
+            // Change: fluids are kept apart in the translucent buffer
+            buildGeometry(isFluid(type) ? result.translucent : result.solid, type, mask, x, y, z);
+        }
+    }
+
+    // Below the world and in the missing chunks everything is dirt.
+    // Above the world the original read past the chunk, it is air here.
+    static uint32_t blockAt(const ChunkData &data, int32_t x, int32_t y, int32_t z) {
+        if (y < 0) {
+            return (uint32_t)BlockType::Dirt;
+        }
+        if (y >= CHUNK_HEIGHT) {
+            return (uint32_t)BlockType::Air;
+        }
+
+        int32_t chunkX = data.x;
+        int32_t chunkY = data.y;
+        if (x < 0) {
+            chunkX--;
+            x += CHUNK_WIDTH;
+        } else if (x >= CHUNK_WIDTH) {
+            chunkX++;
+            x -= CHUNK_WIDTH;
+        }
+        if (z < 0) {
+            chunkY--;
+            z += CHUNK_WIDTH;
+        } else if (z >= CHUNK_WIDTH) {
+            chunkY++;
+            z -= CHUNK_WIDTH;
+        }
+
+        const ChunkData *chunk = &data;
+        if (chunkX != data.x || chunkY != data.y) {
+            auto it = s_chunks.find(ChunkData::posToIndex(chunkX, chunkY));
+            if (it == s_chunks.end()) {
+                return (uint32_t)BlockType::Dirt;
+            }
+            chunk = &it->second;
+        }
+        return chunk->blocks[x + CHUNK_WIDTH * (y * CHUNK_WIDTH + z)];
+    }
+
+    // Original block table, the fluids were left out there
+    static bool isMeshed(BlockType type) {
+        switch (type) {
+        case BlockType::Stone:
+        case BlockType::Grass:
+        case BlockType::Dirt:
+        case BlockType::Cobblestone:
+        case BlockType::Sapling:
+        case BlockType::Planks:
+        case BlockType::Bedrock:
+        case BlockType::Sand:
+        case BlockType::Gravel:
+        case BlockType::GoldOre:
+        case BlockType::IronOre:
+        case BlockType::CoalOre:
+        case BlockType::Log:
+        case BlockType::Leaves:
+        case BlockType::TallGrass: return true;
+        default: break;
+        }
+        // Change: fluids and glass are meshed
+        return isFluid(type) || type == BlockType::Glass;
+    }
+
+    static bool isFluid(BlockType type) {
+        return (type == BlockType::FlowingWater || type == BlockType::Water || type == BlockType::FlowingLava || type == BlockType::Lava);
+    }
+
+    // Original rule, everything but air, leaves and plants hides the faces behind it
+    static bool isSolidBlock(BlockType type) {
+        return (type != BlockType::Air && type != BlockType::Leaves && type != BlockType::TallGrass && type != BlockType::Sapling);
+    }
+
+    static bool isFaceVisible(BlockType type, uint32_t neighbour) {
+        BlockType other = BlockType(neighbour & 0xff);
+        // Change: glass and fluids don't hide faces either
+        bool solid = isSolidBlock(other) && other != BlockType::Glass && !isFluid(other);
+        // Change: faces between two see-through blocks of the same type are hidden
+        if (other == type && !solid) {
+            return false;
+        }
+        return !solid;
+    }
+
+    static void buildGeometry(MeshBuffers &mesh, BlockType type, int8_t mask, int32_t x, int32_t y, int32_t z) {
+        int8_t count = 0;
+        int8_t localMask = mask;
+        for (; localMask; count++) {
+            localMask &= (localMask - 1);
+        }
+
+        Vector3Vector vertices;
+        vertices.resize(count * 4);
+
+        Vector2Vector uvs;
+        uvs.resize(count * 4);
+
+        Vector4Vector colors = Vector4Vector(count * 4, Vector4(1.0f));
+
+        uint32_t v = 0;
+        uint32_t i = mesh.vertices.size();
+
+        if (mask & Top) {
+            vertices[v].x = x;
+            vertices[v].y = y + 1;
+            vertices[v].z = z;
+
+            vertices[v + 1].x = x;
+            vertices[v + 1].y = y + 1;
+            vertices[v + 1].z = z + 1;
+
+            vertices[v + 2].x = x + 1;
+            vertices[v + 2].y = y + 1;
+            vertices[v + 2].z = z;
+
+            vertices[v + 3].x = x + 1;
+            vertices[v + 3].y = y + 1;
+            vertices[v + 3].z = z + 1;
+
+            generateUvs(uvs, type, Top, v);
+
+            v += 4;
+            i += 4;
+
+            addIndices(mesh.indices, i);
+        }
+        if (mask & Bottom) {
+            vertices[v].x = x;
+            vertices[v].y = y;
+            vertices[v].z = z;
+
+            vertices[v + 1].x = x + 1;
+            vertices[v + 1].y = y;
+            vertices[v + 1].z = z;
+
+            vertices[v + 2].x = x;
+            vertices[v + 2].y = y;
+            vertices[v + 2].z = z + 1;
+
+            vertices[v + 3].x = x + 1;
+            vertices[v + 3].y = y;
+            vertices[v + 3].z = z + 1;
+
+            generateUvs(uvs, type, Bottom, v);
+
+            v += 4;
+            i += 4;
+
+            addIndices(mesh.indices, i);
+        }
+        if (mask & Left) {
+            vertices[v].x = x;
+            vertices[v].y = y;
+            vertices[v].z = z + 1;
+
+            vertices[v + 1].x = x;
+            vertices[v + 1].y = y + 1;
+            vertices[v + 1].z = z + 1;
+
+            vertices[v + 2].x = x;
+            vertices[v + 2].y = y;
+            vertices[v + 2].z = z;
+
+            vertices[v + 3].x = x;
+            vertices[v + 3].y = y + 1;
+            vertices[v + 3].z = z;
+
+            generateUvs(uvs, type, Left, v);
+
+            v += 4;
+            i += 4;
+
+            addIndices(mesh.indices, i);
+        }
+        if (mask & Right) {
+            vertices[v].x = x + 1;
+            vertices[v].y = y;
+            vertices[v].z = z;
+
+            vertices[v + 1].x = x + 1;
+            vertices[v + 1].y = y + 1;
+            vertices[v + 1].z = z;
+
+            vertices[v + 2].x = x + 1;
+            vertices[v + 2].y = y;
+            vertices[v + 2].z = z + 1;
+
+            vertices[v + 3].x = x + 1;
+            vertices[v + 3].y = y + 1;
+            vertices[v + 3].z = z + 1;
+
+            generateUvs(uvs, type, Right, v);
+
+            v += 4;
+            i += 4;
+
+            addIndices(mesh.indices, i);
+        }
+        if (mask & Back) {
+            vertices[v].x = x;
+            vertices[v].y = y;
+            vertices[v].z = z;
+
+            vertices[v + 1].x = x;
+            vertices[v + 1].y = y + 1;
+            vertices[v + 1].z = z;
+
+            vertices[v + 2].x = x + 1;
+            vertices[v + 2].y = y;
+            vertices[v + 2].z = z;
+
+            vertices[v + 3].x = x + 1;
+            vertices[v + 3].y = y + 1;
+            vertices[v + 3].z = z;
+
+            generateUvs(uvs, type, Back, v);
+
+            v += 4;
+            i += 4;
+
+            addIndices(mesh.indices, i);
+        }
+        if (mask & Front) {
+            vertices[v].x = x + 1;
+            vertices[v].y = y;
+            vertices[v].z = z + 1;
+
+            vertices[v + 1].x = x + 1;
+            vertices[v + 1].y = y + 1;
+            vertices[v + 1].z = z + 1;
+
+            vertices[v + 2].x = x;
+            vertices[v + 2].y = y;
+            vertices[v + 2].z = z + 1;
+
+            vertices[v + 3].x = x;
+            vertices[v + 3].y = y + 1;
+            vertices[v + 3].z = z + 1;
+
+            generateUvs(uvs, type, Front, v);
+
+            v += 4;
+            i += 4;
+
+            addIndices(mesh.indices, i);
+        }
+
+        mesh.vertices.insert(mesh.vertices.end(), vertices.begin(), vertices.end());
+        mesh.uv0.insert(mesh.uv0.end(), uvs.begin(), uvs.end());
+        mesh.colors.insert(mesh.colors.end(), colors.begin(), colors.end());
+    }
+
+    static void generateUvs(Vector2Vector &uvs, BlockType type, Sides side, uint32_t v) {
+        // Original tiles, grass and log come from GrassBlock
+        int x0 = 0;
+        int y0 = 15;
+        switch (type) {
+        case BlockType::Stone: x0 = 1; y0 = 15; break;
+        case BlockType::Dirt: x0 = 2; y0 = 15; break;
+        case BlockType::Bedrock: x0 = 1; y0 = 14; break;
+        case BlockType::GoldOre: x0 = 0; y0 = 13; break;
+        case BlockType::IronOre: x0 = 1; y0 = 13; break;
+        case BlockType::CoalOre: x0 = 1; y0 = 13; break;
+        case BlockType::Leaves: x0 = 4; y0 = 12; break;
+        case BlockType::Grass: x0 = (side == Top) ? 0 : (side == Bottom) ? 2 : 3; y0 = 15; break;
+        case BlockType::Log: x0 = (side == Top || side == Bottom) ? 5 : 4; y0 = 14; break;
+        default: break;
+        }
+
+        // Change: tiles of the blocks the structures, the fluids, the ores and glass brought in,
+        // coal had the tile of iron
+        switch (type) {
+        case BlockType::Planks: x0 = 4; y0 = 15; break;
+        case BlockType::Cobblestone: x0 = 0; y0 = 14; break;
+        case BlockType::Gravel: x0 = 3; y0 = 14; break;
+        case BlockType::CoalOre: x0 = 2; y0 = 13; break;
+        case BlockType::Glass: x0 = 1; y0 = 12; break;
+        case BlockType::FlowingWater:
+        case BlockType::Water: x0 = 13; y0 = 3; break;
+        case BlockType::FlowingLava:
+        case BlockType::Lava: x0 = 13; y0 = 1; break;
+        default: break;
+        }
+
+        const float tileWidth = 16.0f / 256.0f;
+        const float tileHeight = 16.0f / 256.0f;
+
+        float x1 = x0 * tileWidth;
+        float x2 = (x0 + 1) * tileWidth;
+
+        float y1 = y0 * tileHeight;
+        float y2 = (y0 + 1) * tileHeight;
+
+        uvs[v].x = x1;
+        uvs[v].y = y1;
+
+        uvs[v + 1].x = x1;
+        uvs[v + 1].y = y2;
+
+        uvs[v + 2].x = x2;
+        uvs[v + 2].y = y1;
+
+        uvs[v + 3].x = x2;
+        uvs[v + 3].y = y2;
+    }
+
+    static void addIndices(IndexVector &indices, uint32_t i) {
+        indices.insert(indices.end(), {i - 4, i - 3, i - 2, i - 3, i - 1, i - 2});
+    }
+
+};
+
+// Meshes randomized and adversarial chunks with both the optimised and the reference mesher and compares the results
+class MesherCheck {
+    // Mesh, bounds of the quad in 1/8 of the block and the atlas tile
+    typedef std::array<int32_t, 9> Face;
+
+public:
+    static bool run(uint32_t seed, int32_t cases) {
+        std::minstd_rand random(seed + 1);
+
+        ScratchWorld world;
+        ChunkRenderer *renderer = Engine::objectCreate<ChunkRenderer>("MesherCheck");
+
+        ChunkMeshCache candidate;
+        ChunkMeshCache reference;
+
+        uint32_t mismatches = 0;
+        uint32_t failed = 0;
+        float candidateTime = 0.0f;
+        float referenceTime = 0.0f;
+
+        for(int32_t c = 0; c < cases; c++) {
+            createNeighbourhood(random, c % 5);
+
+            ChunkData &data = *ScratchWorld::chunk(0, 0);
+
+            auto start = std::chrono::steady_clock::now();
+            renderer->setChunkData(data);
+            auto middle = std::chrono::steady_clock::now();
+            renderer->exportMeshes(candidate);
+
+            ReferenceMesher::build(data, reference);
+            auto end = std::chrono::steady_clock::now();
+
+            candidateTime += std::chrono::duration<float>(middle - start).count();
+            referenceTime += std::chrono::duration<float>(end - middle).count();
+
+            uint32_t difference = compare(candidate, reference);
+            bool identical = isIdentical(candidate, reference);
+            if(difference > 0 || !identical) {
+                aError() << "Mesher check case" << c << "kind" << c % 5 << "differs by" << int(difference) << "faces," << (identical ? "same" : "different") << "buffers";
+                failed++;
+            }
+            mismatches += difference;
+
+            // The same chunk after the edits, only the touched sections are remeshed and spliced in
+            uint32_t mask = editChunk(data, random);
+            renderer->RebuildSections(mask);
+            renderer->exportMeshes(candidate);
+            ReferenceMesher::build(data, reference);
+            sortInstances(candidate);
+            sortInstances(reference);
+
+            difference = compare(candidate, reference);
+            identical = isIdentical(candidate, reference);
+            if(difference > 0 || !identical) {
+                aError() << "Mesher check case" << c << "kind" << c % 5 << "after the edits of the sections" << mask << "differs by" << int(difference) << "faces," << (identical ? "same" : "different") << "buffers";
+                failed++;
+            }
+            mismatches += difference;
+
+            renderer->resetChunkData();
+            ScratchWorld::clear();
+        }
+
+        delete renderer;
+
+        aInfo() << "Mesher check:" << cases << "cases," << int(failed) << "failed," << int(mismatches) << "mismatched faces";
+        aInfo() << "Mesher check: reference" << cases / MAX(referenceTime, 0.0001f) << "chunks/s, candidate" << cases / MAX(candidateTime, 0.0001f) << "chunks/s";
+
+        return failed == 0;
+    }
+
+protected:
+    template<typename T>
+    static bool isSame(const std::vector<T> &a, const std::vector<T> &b) {
+        return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+
+    // Geometry must be byte identical, only the translucent quads may come in another order after the sorting
+    static bool isIdentical(const ChunkMeshCache &candidate, const ChunkMeshCache &reference) {
+        const MeshBuffers &a = candidate.solid;
+        const MeshBuffers &b = reference.solid;
+        if(!isSame(a.vertices, b.vertices) || !isSame(a.uv0, b.uv0) || !isSame(a.colors, b.colors) || !isSame(a.indices, b.indices)) {
+            return false;
+        }
+
+        const MeshBuffers &c = candidate.translucent;
+        const MeshBuffers &d = reference.translucent;
+        if(!isSame(c.vertices, d.vertices) || !isSame(c.uv0, d.uv0) || !isSame(c.colors, d.colors) || sortedQuads(c.indices) != sortedQuads(d.indices)) {
+            return false;
+        }
+
+        if(candidate.instances.size() != reference.instances.size()) {
+            return false;
+        }
+        for(size_t i = 0; i < candidate.instances.size(); i++) {
+            if(candidate.instances[i].index != reference.instances[i].index || candidate.instances[i].type != reference.instances[i].type) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static std::vector<std::array<uint32_t, 6>> sortedQuads(const IndexVector &indices) {
+        std::vector<std::array<uint32_t, 6>> result(indices.size() / 6);
+        for(size_t q = 0; q < result.size(); q++) {
+            std::copy(indices.begin() + q * 6, indices.begin() + q * 6 + 6, result[q].begin());
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    static uint32_t compare(const ChunkMeshCache &candidate, const ChunkMeshCache &reference) {
+        std::vector<Face> a;
+        std::vector<Face> b;
+        collectFaces(candidate.solid, 0, a);
+        collectFaces(candidate.translucent, 1, a);
+        collectFaces(reference.solid, 0, b);
+        collectFaces(reference.translucent, 1, b);
+
+        for(auto &it : candidate.instances) {
+            a.push_back({2, int32_t(it.index), int32_t(it.type), 0, 0, 0, 0, 0, 0});
+        }
+        for(auto &it : reference.instances) {
+            b.push_back({2, int32_t(it.index), int32_t(it.type), 0, 0, 0, 0, 0, 0});
+        }
+
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+
+        std::vector<Face> difference;
+        std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(difference));
+        return difference.size();
+    }
+
+    // The order of the faces doesn't matter, only the covered surfaces and their tiles do
+    static void collectFaces(const MeshBuffers &mesh, int32_t type, std::vector<Face> &faces) {
+        for(size_t v = 0; v + 3 < mesh.vertices.size(); v += 4) {
+            Face face = {type, INT32_MAX, INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX};
+            for(size_t i = v; i < v + 4; i++) {
+                for(int32_t axis = 0; axis < 3; axis++) {
+                    int32_t value = int32_t(roundf(mesh.vertices[i][axis] * 8.0f));
+                    face[1 + axis] = MIN(face[1 + axis], value);
+                    face[4 + axis] = MAX(face[4 + axis], value);
+                }
+                if(i < mesh.uv0.size()) {
+                    face[7] = MIN(face[7], int32_t(floorf(mesh.uv0[i].x * 16.0f + 0.01f)));
+                    face[8] = MIN(face[8], int32_t(floorf(mesh.uv0[i].y * 16.0f + 0.01f)));
+                }
+            }
+            faces.push_back(face);
+        }
+    }
+
+    // The spliced instances keep the order of the edits
+    static void sortInstances(ChunkMeshCache &cache) {
+        std::sort(cache.instances.begin(), cache.instances.end(), [](const VegetationInstance &a, const VegetationInstance &b) {
+            return a.index < b.index;
+        });
+    }
+
+    // Blocks on the lowest and the highest layer of a few sections are changed and some sections are emptied,
+    // returns the sections asked to remesh for the center chunk
+    static uint32_t editChunk(ChunkData &data, std::minstd_rand &random) {
+        int32_t originX = data.x * CHUNK_WIDTH;
+        int32_t originZ = data.y * CHUNK_WIDTH;
+
+        for(int32_t e = 0; e < 3; e++) {
+            int32_t s = random() % SECTIONS;
+            if(random() % 3 == 0) {
+                for(int32_t y = s * SECTION_HEIGHT; y < (s + 1) * SECTION_HEIGHT; y++) {
+                    for(int32_t x = 0; x < CHUNK_WIDTH; x++) {
+                        for(int32_t z = 0; z < CHUNK_WIDTH; z++) {
+                            data.write(ChunkData::blockIndex(x, y, z), (uint32_t)BlockType::Air);
+                        }
+                    }
+                }
+                markBoxDirty(originX, s * SECTION_HEIGHT, originZ, originX + CHUNK_WIDTH - 1, (s + 1) * SECTION_HEIGHT - 1, originZ + CHUNK_WIDTH - 1);
+                continue;
+            }
+
+            for(int32_t i = 0; i < 16; i++) {
+                int32_t x = random() % CHUNK_WIDTH;
+                int32_t z = random() % CHUNK_WIDTH;
+                int32_t y = s * SECTION_HEIGHT + ((random() % 2) ? 0 : SECTION_HEIGHT - 1);
+                data.write(ChunkData::blockIndex(x, y, z), (random() % 4 == 0) ? (uint32_t)BlockType::Air : (uint32_t)pick(random));
+                markBlockDirty(originX + x, y, originZ + z);
+            }
+        }
+
+        uint32_t mask = s_dirtySections[ChunkData::posToIndex(data.x, data.y)];
+        s_dirtySections.clear();
+        return mask;
+    }
+
+    static BlockType pick(std::minstd_rand &random) {
+        static const BlockType palette[] = {
+            BlockType::Stone, BlockType::Grass, BlockType::Dirt, BlockType::Bedrock, BlockType::Sand, BlockType::Log,
+            BlockType::Leaves, BlockType::Glass, BlockType::Water, BlockType::FlowingWater, BlockType::Lava,
+            BlockType::TallGrass, BlockType::Sapling
+        };
+        return palette[random() % (sizeof(palette) / sizeof(palette[0]))];
+    }
+
+    // Center chunk with all the 8 neighbours, some of the neighbours are left out to check the missing borders
+    static void createNeighbourhood(std::minstd_rand &random, int32_t kind) {
+        for(int32_t i = -1; i <= 1; i++) {
+            for(int32_t j = -1; j <= 1; j++) {
+                if((i != 0 || j != 0) && random() % 6 == 0) {
+                    continue;
+                }
+
+                ChunkData &data = ScratchWorld::createChunk(i, j);
+                fillChunk(data, random, kind);
+                data.recount();
+            }
+        }
+
+        if(kind == 4) {
+            // Edits along the borders go through write() to check the incremental metadata
+            for(int32_t e = 0; e < 256; e++) {
+                ChunkData *data = ScratchWorld::chunk(int32_t(random() % 3) - 1, int32_t(random() % 3) - 1);
+                if(data == nullptr) {
+                    continue;
+                }
+                int32_t x = (random() % 2) ? 0 : CHUNK_WIDTH - 1;
+                int32_t z = random() % CHUNK_WIDTH;
+                if(random() % 2) {
+                    std::swap(x, z);
+                }
+                BlockType type = (random() % 3 == 0) ? BlockType::Air : pick(random);
+                data->write(ChunkData::blockIndex(x, random() % 128, z), (uint32_t)type);
+            }
+        }
+    }
+
+    static void fillChunk(ChunkData &data, std::minstd_rand &random, int32_t kind) {
+        switch(kind) {
+        case 0: { // Noise of all the block kinds
+            int32_t top = 1 + random() % CHUNK_HEIGHT;
+            for(int32_t i = 0; i < top * CHUNK_WIDTH * CHUNK_WIDTH; i++) {
+                if(random() % 10 < 3) {
+                    data.blocks[i] = (uint32_t)pick(random);
+                }
+            }
+        } break;
+        case 2: { // Buried sections, only some of the chunks have holes
+            int32_t top = 64 + random() % 64;
+            bool holes = (random() % 2 == 0);
+            for(int32_t i = 0; i < top * CHUNK_WIDTH * CHUNK_WIDTH; i++) {
+                data.blocks[i] = (uint32_t)((holes && random() % 500 == 0) ? BlockType::Air : BlockType::Stone);
+            }
+        } break;
+        case 3: { // Sparse blocks at the limits of the height
+            for(int32_t i = 0; i < 64; i++) {
+                int32_t y = (random() % 2) ? random() % 3 : CHUNK_HEIGHT - 1 - random() % 3;
+                data.blocks[ChunkData::blockIndex(random() % CHUNK_WIDTH, y, random() % CHUNK_WIDTH)] = (uint32_t)pick(random);
+            }
+        } break;
+        default: { // Terrain with vegetation, canopies and pools
+            for(int32_t x = 0; x < CHUNK_WIDTH; x++) {
+                for(int32_t z = 0; z < CHUNK_WIDTH; z++) {
+                    int32_t height = 20 + random() % 40;
+                    for(int32_t y = 0; y < height; y++) {
+                        BlockType type = (y < 3) ? BlockType::Bedrock : (y < height - 3) ? BlockType::Stone : BlockType::Dirt;
+                        if(y == height - 1) {
+                            type = (random() % 8 == 0) ? BlockType::Water : BlockType::Grass;
+                        }
+                        data.blocks[ChunkData::blockIndex(x, y, z)] = (uint32_t)type;
+                    }
+                    uint32_t r = random() % 16;
+                    if(r < 3) {
+                        data.blocks[ChunkData::blockIndex(x, height, z)] = (uint32_t)BlockType::TallGrass;
+                    } else if(r < 5) {
+                        for(int32_t y = height + 4; y < height + 8; y++) {
+                            data.blocks[ChunkData::blockIndex(x, y, z)] = (uint32_t)BlockType::Leaves;
+                        }
+                    } else if(r == 5) {
+                        data.blocks[ChunkData::blockIndex(x, height, z)] = (uint32_t)BlockType::Glass;
+                    }
+                }
+            }
+        } break;
+        }
+    }
+
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "ChunkRenderer.cpp"
+
+// Seeded gradient noise, pure functions so chunks can be generated on any thread
+class Noise {
+public:
+    static uint32_t hash(int32_t seed, int32_t x, int32_t y, int32_t z) {
+        uint32_t h = uint32_t(seed) * 0x27d4eb2dU;
+        h ^= uint32_t(x) * 0x8da6b343U;
+        h ^= uint32_t(y) * 0xd8163841U;
+        h ^= uint32_t(z) * 0xcb1ab31fU;
+        h ^= h >> 15;
+        h *= 0x2c1b3c6dU;
+        h ^= h >> 12;
+        return h;
+    }
+
+    static float gradient(int32_t seed, float x, float y, float z) {
+        int32_t x0 = int32_t(floorf(x));
+        int32_t y0 = int32_t(floorf(y));
+        int32_t z0 = int32_t(floorf(z));
+
+        float fx = x - x0;
+        float fy = y - y0;
+        float fz = z - z0;
+
+        float u = fade(fx);
+        float v = fade(fy);
+        float w = fade(fz);
+
+        float x00 = lerp(dot(seed, x0, y0, z0, fx, fy, fz), dot(seed, x0 + 1, y0, z0, fx - 1.0f, fy, fz), u);
+        float x10 = lerp(dot(seed, x0, y0 + 1, z0, fx, fy - 1.0f, fz), dot(seed, x0 + 1, y0 + 1, z0, fx - 1.0f, fy - 1.0f, fz), u);
+        float x01 = lerp(dot(seed, x0, y0, z0 + 1, fx, fy, fz - 1.0f), dot(seed, x0 + 1, y0, z0 + 1, fx - 1.0f, fy, fz - 1.0f), u);
+        float x11 = lerp(dot(seed, x0, y0 + 1, z0 + 1, fx, fy - 1.0f, fz - 1.0f), dot(seed, x0 + 1, y0 + 1, z0 + 1, fx - 1.0f, fy - 1.0f, fz - 1.0f), u);
+
+        return lerp(lerp(x00, x10, v), lerp(x01, x11, v), w);
+    }
+
+    static inline float lerp(float a, float b, float t) {
+        return a + (b - a) * t;
+    }
+
+protected:
+    static inline float fade(float t) {
+        return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+    }
+
+    static inline float dot(int32_t seed, int32_t x, int32_t y, int32_t z, float dx, float dy, float dz) {
+        // One of the 12 cube edge directions
+        switch(hash(seed, x, y, z) % 12) {
+        case 0: return  dx + dy;
+        case 1: return -dx + dy;
+        case 2: return  dx - dy;
+        case 3: return -dx - dy;
+        case 4: return  dx + dz;
+        case 5: return -dx + dz;
+        case 6: return  dx - dz;
+        case 7: return -dx - dz;
+        case 8: return  dy + dz;
+        case 9: return -dy + dz;
+        case 10: return  dy - dz;
+        default: return -dy - dz;
+        }
+    }
+
+};
+
+#define LATTICE_X 4
+#define LATTICE_Y 8
+#define LATTICE_Z 4
+
+// Noise sampled on a coarse lattice over the chunk and trilinearly interpolated for every block
+class NoiseLattice {
+    static const int32_t sizeX = CHUNK_WIDTH / LATTICE_X + 1;
+    static const int32_t sizeZ = CHUNK_WIDTH / LATTICE_Z + 1;
+
+    std::vector<float> m_values;
+    int32_t m_sizeY = 0;
+
+public:
+    void sample(int32_t seed, int32_t chunkX, int32_t chunkY, int32_t height, float frequency, float verticalFrequency) {
+        m_sizeY = height / LATTICE_Y + 2;
+        m_values.resize(sizeX * m_sizeY * sizeZ);
+
+        for(int32_t i = 0; i < sizeX; i++) {
+            for(int32_t k = 0; k < sizeZ; k++) {
+                float x = (chunkX * CHUNK_WIDTH + i * LATTICE_X) * frequency;
+                float z = (chunkY * CHUNK_WIDTH + k * LATTICE_Z) * frequency;
+                for(int32_t j = 0; j < m_sizeY; j++) {
+                    m_values[(j * sizeZ + k) * sizeX + i] = Noise::gradient(seed, x, j * LATTICE_Y * verticalFrequency, z);
+                }
+            }
+        }
+    }
+
+    float value(int32_t x, int32_t y, int32_t z) const {
+        int32_t i = x / LATTICE_X;
+        int32_t j = y / LATTICE_Y;
+        int32_t k = z / LATTICE_Z;
+
+        float fx = float(x % LATTICE_X) / LATTICE_X;
+        float fy = float(y % LATTICE_Y) / LATTICE_Y;
+        float fz = float(z % LATTICE_Z) / LATTICE_Z;
+
+        float c00 = Noise::lerp(at(i, j, k), at(i + 1, j, k), fx);
+        float c10 = Noise::lerp(at(i, j + 1, k), at(i + 1, j + 1, k), fx);
+        float c01 = Noise::lerp(at(i, j, k + 1), at(i + 1, j, k + 1), fx);
+        float c11 = Noise::lerp(at(i, j + 1, k + 1), at(i + 1, j + 1, k + 1), fx);
+
+        return Noise::lerp(Noise::lerp(c00, c10, fy), Noise::lerp(c01, c11, fy), fz);
+    }
+
+protected:
+    inline float at(int32_t i, int32_t j, int32_t k) const {
+        return m_values[(j * sizeZ + k) * sizeX + i];
+    }
+
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <random>
+
+#include "VoxelPhysics.cpp"
+#include "ScratchWorld.cpp"
+
+#define PHYSICS_CHECK_PLAYERS 256
+#define PHYSICS_CHECK_TICKS 400
+
+typedef void (*WorldGenerator)(int32_t seed);
+
+// Runs many headless players over a freshly generated scratch world with the voxel physics and measures the tick rate
+class PhysicsCheck {
+    struct Player {
+        VoxelBody body;
+        Vector3 velocity;
+        float heading = 0.0f; // radians
+    };
+
+public:
+    static bool run(uint32_t seed, int32_t size, float interval, WorldGenerator generator) {
+        std::minstd_rand random(seed + 1);
+
+        ScratchWorld world;
+        generator(seed);
+
+        const float speed = 6.0f;
+        const float jumpSpeed = 5.0f;
+        const float gravity = 20.0f;
+        const float width = float(size * CHUNK_WIDTH);
+
+        std::vector<Player> players(PHYSICS_CHECK_PLAYERS);
+        for(auto &it : players) {
+            int32_t x = 2 + random() % (size * CHUNK_WIDTH - 4);
+            int32_t z = 2 + random() % (size * CHUNK_WIDTH - 4);
+            it.body.setPosition(Vector3(x + 0.5f, spawnHeight(x, z) + it.body.extent().y + VOXEL_EPSILON, z + 0.5f));
+            it.heading = float(random() % 628) * 0.01f;
+        }
+
+        uint64_t moves = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(int32_t t = 0; t < PHYSICS_CHECK_TICKS; t++) {
+            for(auto &it : players) {
+                Vector3 position = it.body.position();
+                if(random() % 20 == 0) {
+                    it.heading += float(int32_t(random() % 314) - 157) * 0.01f;
+                }
+                // Players turn back at the border of the world, there are no blocks to stand on behind it
+                if(position.x < 2.0f || position.z < 2.0f || position.x > width - 2.0f || position.z > width - 2.0f) {
+                    it.heading = atan2f(width * 0.5f - position.z, width * 0.5f - position.x);
+                }
+
+                it.velocity.x = cosf(it.heading) * speed;
+                it.velocity.z = sinf(it.heading) * speed;
+                if(it.body.isGrounded() && random() % 10 == 0) {
+                    it.velocity.y = jumpSpeed;
+                } else {
+                    it.velocity.y = MAX(it.velocity.y - gravity * interval, -50.0f);
+                }
+
+                it.body.move(it.velocity * interval);
+                if((it.body.isGrounded() && it.velocity.y < 0.0f) || (it.body.hitCeiling() && it.velocity.y > 0.0f)) {
+                    it.velocity.y = 0.0f;
+                }
+                moves++;
+            }
+        }
+        std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+
+        uint32_t stuck = 0;
+        uint32_t fallen = 0;
+        for(auto &it : players) {
+            if(it.body.isStuck()) {
+                stuck++;
+            }
+            if(it.body.position().y < 0.0f) {
+                fallen++;
+            }
+        }
+
+        float seconds = MAX(elapsed.count(), 0.0001f);
+        aInfo() << "Physics check:" << PHYSICS_CHECK_PLAYERS << "players," << PHYSICS_CHECK_TICKS << "ticks," << int(stuck) << "stuck," << int(fallen) << "fallen";
+        aInfo() << "Physics check:" << PHYSICS_CHECK_TICKS / seconds << "ticks/s," << moves / seconds << "body moves/s," << seconds * 1000.0f / PHYSICS_CHECK_TICKS << "ms per tick";
+
+        if(stuck > 0 || fallen > 0) {
+            aError() << "Physics check failed:" << int(stuck) << "players stuck in the blocks," << int(fallen) << "fell through the world";
+        }
+        return stuck == 0 && fallen == 0;
+    }
+
+protected:
+    static int32_t spawnHeight(int32_t x, int32_t z) {
+        for(int32_t y = CHUNK_HEIGHT - 1; y >= 0; y--) {
+            if(VoxelBody::isSolidAt(x, y, z)) {
+                return y + 1;
+            }
+        }
+        return 0;
+    }
+
+};
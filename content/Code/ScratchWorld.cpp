@@ -0,0 +1,106 @@
+#pragma once
+
+#include "WorldAccess.cpp"
+
+#define CHECK_ORIGIN 4096
+
+// World of the self checks. While it exists the live chunks, dirty sections and queued edits are put aside
+// and the journal doesn't record, everything comes back untouched when it is destroyed.
+class ScratchWorld {
+    std::unordered_map<uint64_t, ChunkData> m_chunks;
+    std::unordered_map<uint64_t, uint32_t> m_dirtySections;
+    BlockEdit *m_edits = nullptr;
+    bool m_recording = false;
+
+public:
+    ScratchWorld() {
+        {
+            std::unique_lock<std::shared_mutex> guard(s_chunksLock);
+            m_chunks.swap(s_chunks);
+        }
+        m_dirtySections.swap(s_dirtySections);
+        m_edits = s_edits.takeAll();
+
+        m_recording = s_journal.isRecording();
+        s_journal.setRecording(false);
+    }
+
+    ~ScratchWorld() {
+        {
+            std::unique_lock<std::shared_mutex> guard(s_chunksLock);
+            m_chunks.swap(s_chunks);
+        }
+        m_dirtySections.swap(s_dirtySections);
+
+        EditQueue::release(s_edits.takeAll());
+        for(BlockEdit *edit = m_edits; edit; edit = edit->next) {
+            s_edits.push(edit->x, edit->y, edit->z, edit->type);
+        }
+        EditQueue::release(m_edits);
+
+        s_journal.setRecording(m_recording);
+    }
+
+    // Empty chunk at the offset from the check origin, the origin keeps all the coordinates positive.
+    // Blocks written directly afterwards need ChunkData::recount().
+    static ChunkData &createChunk(int32_t i, int32_t j) {
+        std::unique_lock<std::shared_mutex> guard(s_chunksLock);
+        ChunkData &data = s_chunks[ChunkData::posToIndex(CHECK_ORIGIN + i, CHECK_ORIGIN + j)];
+        data.x = CHECK_ORIGIN + i;
+        data.y = CHECK_ORIGIN + j;
+        data.blocks.assign(CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_WIDTH, 0);
+        for(int32_t s = 0; s < SECTIONS; s++) {
+            data.tickable[s] = 0;
+            data.filled[s] = 0;
+            data.opaque[s] = 0;
+        }
+        for(int32_t c = 0; c < CHUNK_WIDTH * CHUNK_WIDTH; c++) {
+            data.height[c] = -1;
+            data.opaqueHeight[c] = -1;
+        }
+        data.revision = 0;
+        return data;
+    }
+
+    static ChunkData *chunk(int32_t i, int32_t j) {
+        auto it = s_chunks.find(ChunkData::posToIndex(CHECK_ORIGIN + i, CHECK_ORIGIN + j));
+        return (it != s_chunks.end()) ? &it->second : nullptr;
+    }
+
+    static void eraseChunk(int32_t i, int32_t j) {
+        std::unique_lock<std::shared_mutex> guard(s_chunksLock);
+        s_chunks.erase(ChunkData::posToIndex(CHECK_ORIGIN + i, CHECK_ORIGIN + j));
+    }
+
+    static void clear() {
+        std::unique_lock<std::shared_mutex> guard(s_chunksLock);
+        s_chunks.clear();
+        s_dirtySections.clear();
+    }
+
+    // Chunks of the size x size square at the origin
+    template<typename Function>
+    static void forEachChunk(int32_t size, Function function) {
+        for(int32_t i = 0; i < size; i++) {
+            for(int32_t j = 0; j < size; j++) {
+                ChunkData *data = chunk(i, j);
+                if(data) {
+                    function(*data);
+                }
+            }
+        }
+    }
+
+    // Number of the sections asked to remesh, there are no renderers in the scratch world so the requests are dropped
+    static uint32_t takeDirtySections() {
+        uint32_t result = 0;
+        for(auto &it : s_dirtySections) {
+            for(uint32_t mask = it.second; mask; mask &= mask - 1) {
+                result++;
+            }
+        }
+        s_dirtySections.clear();
+        return result;
+    }
+
+};
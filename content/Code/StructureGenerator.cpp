@@ -0,0 +1,260 @@
+#pragma once
+
+#include "ChunkRenderer.cpp"
+
+enum class StructureType {
+    OakTree,
+    TallTree,
+    SpruceTree,
+    Boulder,
+    Hut,
+    Count
+};
+
+// Precompiled sparse set of blocks relative to the structure origin
+struct Stamp {
+    struct Block {
+        int8_t x;
+        int8_t y;
+        int8_t z;
+        BlockType type;
+        bool replace;
+    };
+
+    std::vector<Block> blocks;
+    int32_t minX = 0;
+    int32_t maxX = 0;
+    int32_t minY = 0;
+    int32_t maxY = 0;
+    int32_t minZ = 0;
+    int32_t maxZ = 0;
+
+    void add(int32_t x, int32_t y, int32_t z, BlockType type, bool replace) {
+        blocks.push_back({int8_t(x), int8_t(y), int8_t(z), type, replace});
+        minX = MIN(minX, x);
+        maxX = MAX(maxX, x);
+        minY = MIN(minY, y);
+        maxY = MAX(maxY, y);
+        minZ = MIN(minZ, z);
+        maxZ = MAX(maxZ, z);
+    }
+};
+
+class StructureGenerator {
+    Stamp m_stamps[int(StructureType::Count)];
+
+public:
+    StructureGenerator() {
+        compileTree(m_stamps[int(StructureType::OakTree)], 7, 1, 4);
+        compileTree(m_stamps[int(StructureType::TallTree)], 9, 1, 3);
+        compileSpruce(m_stamps[int(StructureType::SpruceTree)]);
+        compileBoulder(m_stamps[int(StructureType::Boulder)]);
+        compileHut(m_stamps[int(StructureType::Hut)]);
+    }
+
+    static bool isTree(StructureType type) {
+        return (type == StructureType::OakTree || type == StructureType::TallTree || type == StructureType::SpruceTree);
+    }
+
+    const Stamp &stamp(StructureType type) const {
+        return m_stamps[int(type)];
+    }
+
+    // Blocks replaced by the stamp may only be air or plants, the whole stamp must be within the world height
+    bool fits(StructureType type, int32_t x, int32_t y, int32_t z) const {
+        const Stamp &stamp = m_stamps[int(type)];
+        if(y + stamp.minY < 0 || y + stamp.maxY >= CHUNK_HEIGHT) {
+            return false;
+        }
+
+        StampChunks chunks;
+        if(!resolveChunks(stamp, x, z, chunks)) {
+            return false;
+        }
+
+        for(auto &it : stamp.blocks) {
+            if(!it.replace) {
+                continue;
+            }
+            int32_t bx = x + it.x;
+            int32_t bz = z + it.z;
+            ChunkData *data = chunks.find(bx, bz);
+            if(data == nullptr) {
+                return false;
+            }
+            size_t index = ChunkData::blockIndex(bx - data->x * CHUNK_WIDTH, y + it.y, bz - data->y * CHUNK_WIDTH);
+            BlockType current = ChunkRenderer::unpackType(data->blocks[index]);
+            if(current != BlockType::Air && current != BlockType::TallGrass && current != BlockType::Sapling && current != BlockType::Leaves) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void place(StructureType type, int32_t x, int32_t y, int32_t z) const {
+        const Stamp &stamp = m_stamps[int(type)];
+
+        StampChunks chunks;
+        if(!resolveChunks(stamp, x, z, chunks)) {
+            return;
+        }
+
+        for(auto &it : stamp.blocks) {
+            int32_t bx = x + it.x;
+            int32_t by = y + it.y;
+            int32_t bz = z + it.z;
+            if(by < 0 || by >= CHUNK_HEIGHT) {
+                continue;
+            }
+
+            ChunkData *data = chunks.find(bx, bz);
+            if(data == nullptr) {
+                continue;
+            }
+
+            size_t index = ChunkData::blockIndex(bx - data->x * CHUNK_WIDTH, by, bz - data->y * CHUNK_WIDTH);
+            BlockType current = ChunkRenderer::unpackType(data->blocks[index]);
+            if(current == BlockType::Bedrock) {
+                continue;
+            }
+            if(it.replace || current == BlockType::Air || current == BlockType::TallGrass) {
+                data->write(index, (uint32_t)it.type);
+            }
+        }
+
+        markBoxDirty(x + stamp.minX, y + stamp.minY, z + stamp.minZ, x + stamp.maxX, y + stamp.maxY, z + stamp.maxZ);
+    }
+
+protected:
+    // Up to 2x2 chunks under the stamp, missing ones are null
+    struct StampChunks {
+        ChunkData *chunks[4] = {nullptr, nullptr, nullptr, nullptr};
+        int32_t minX = 0;
+        int32_t minZ = 0;
+
+        ChunkData *find(int32_t x, int32_t z) const {
+            return chunks[(floorChunk(x) - minX) * 2 + (floorChunk(z) - minZ)];
+        }
+    };
+
+    // Chunks under the stamp are resolved once, then every block goes straight to its chunk
+    static bool resolveChunks(const Stamp &stamp, int32_t x, int32_t z, StampChunks &result) {
+        result.minX = floorChunk(x + stamp.minX);
+        result.minZ = floorChunk(z + stamp.minZ);
+        int32_t countX = floorChunk(x + stamp.maxX) - result.minX + 1;
+        int32_t countZ = floorChunk(z + stamp.maxZ) - result.minZ + 1;
+        if(countX > 2 || countZ > 2) {
+            return false;
+        }
+
+        for(int32_t i = 0; i < countX; i++) {
+            for(int32_t j = 0; j < countZ; j++) {
+                if(result.minX + i < 0 || result.minZ + j < 0) {
+                    continue;
+                }
+                auto it = s_chunks.find(ChunkData::posToIndex(result.minX + i, result.minZ + j));
+                if(it != s_chunks.end()) {
+                    result.chunks[i * 2 + j] = &it->second;
+                }
+            }
+        }
+        return true;
+    }
+
+    static int32_t floorChunk(int32_t value) {
+        return (value >= 0) ? value / CHUNK_WIDTH : (value - CHUNK_WIDTH + 1) / CHUNK_WIDTH;
+    }
+
+    static void compileTree(Stamp &stamp, int32_t height, int32_t minRadius, int32_t maxRadius) {
+        for(int32_t radius = minRadius; radius < maxRadius; radius++) {
+            for(int32_t i = -radius; i <= radius; i++) {
+                for(int32_t j = -radius; j <= radius; j++) {
+                    float distance = sqrtf(i*i + j*j) - 0.2f;
+                    if(distance < radius) {
+                        stamp.add(i, height - radius, j, BlockType::Leaves, false);
+                    }
+                }
+            }
+        }
+
+        for(int32_t i = 0; i < height - 1; i++) {
+            stamp.add(0, i, 0, BlockType::Log, true);
+        }
+    }
+
+    static void compileSpruce(Stamp &stamp) {
+        const int32_t height = 9;
+        // Canopy layers from the tip down, the tip sits right above the trunk
+        const int32_t layers[] = {0, 1, 1, 2, 1, 2};
+
+        int32_t y = height - 1;
+        for(int32_t radius : layers) {
+            for(int32_t i = -radius; i <= radius; i++) {
+                for(int32_t j = -radius; j <= radius; j++) {
+                    if(radius < 2 || abs(i) + abs(j) < 4) {
+                        stamp.add(i, y, j, BlockType::Leaves, false);
+                    }
+                }
+            }
+            y--;
+        }
+
+        for(int32_t i = 0; i < height - 1; i++) {
+            stamp.add(0, i, 0, BlockType::Log, true);
+        }
+    }
+
+    static void compileBoulder(Stamp &stamp) {
+        for(int32_t i = -2; i <= 2; i++) {
+            for(int32_t j = -1; j <= 2; j++) {
+                for(int32_t k = -2; k <= 2; k++) {
+                    if(i*i + j*j + k*k > 4) {
+                        continue;
+                    }
+                    uint32_t hash = uint32_t(i * 73856093) ^ uint32_t(j * 19349663) ^ uint32_t(k * 83492791);
+                    BlockType type = BlockType::Cobblestone;
+                    if(hash % 5 == 0) {
+                        type = BlockType::Stone;
+                    } else if(hash % 7 == 0) {
+                        type = BlockType::Gravel;
+                    }
+                    stamp.add(i, j, k, type, true);
+                }
+            }
+        }
+    }
+
+    static void compileHut(Stamp &stamp) {
+        const int32_t half = 2;
+        const int32_t height = 3;
+
+        for(int32_t i = -half; i <= half; i++) {
+            for(int32_t j = -half; j <= half; j++) {
+                bool wall = (abs(i) == half || abs(j) == half);
+                bool corner = (abs(i) == half && abs(j) == half);
+
+                // Foundation fills the gaps under uneven terrain
+                stamp.add(i, -3, j, BlockType::Cobblestone, false);
+                stamp.add(i, -2, j, BlockType::Cobblestone, false);
+                stamp.add(i, -1, j, BlockType::Cobblestone, true);
+
+                for(int32_t y = 0; y < height; y++) {
+                    bool door = (i == 0 && j == half && y < 2);
+                    bool window = (j == 0 && abs(i) == half && y == 1);
+                    if(corner) {
+                        stamp.add(i, y, j, BlockType::Log, true);
+                    } else if(wall && !door && !window) {
+                        stamp.add(i, y, j, BlockType::Planks, true);
+                    } else {
+                        stamp.add(i, y, j, BlockType::Air, true);
+                    }
+                }
+
+                stamp.add(i, height, j, BlockType::Planks, true);
+            }
+        }
+    }
+
+};
+
+static const StructureGenerator s_structures;
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "ChunkRenderer.cpp"
+
+#define VOXEL_EPSILON 0.001f
+
+// Axis aligned box moving directly against the block storage, doesn't need any collider meshes
+class VoxelBody {
+    Vector3 m_position;
+    Vector3 m_extent = Vector3(0.3f, 0.9f, 0.3f);
+
+    float m_stepHeight = 1.0f;
+
+    bool m_grounded = false;
+    bool m_hitCeiling = false;
+
+public:
+    static bool isCollidable(BlockType type) {
+        if(type == BlockType::Air) {
+            return false;
+        }
+        auto it = s_blockTypes.find(type);
+        return (it != s_blockTypes.end() && it->second->isCollidable());
+    }
+
+    static bool isSolidAt(int32_t x, int32_t y, int32_t z) {
+        if(y < 0) {
+            return true;
+        }
+        uint32_t *block = blockAt(x, y, z);
+        return block && isCollidable(ChunkRenderer::unpackType(*block));
+    }
+
+    // Moves the body resolving collisions axis by axis, vertical axis goes first
+    void move(const Vector3 &delta) {
+        m_hitCeiling = false;
+        bool wasGrounded = m_grounded;
+        m_grounded = false;
+
+        // Splitting long moves keeps the box from passing through the blocks
+        float length = MAX(fabsf(delta.x), MAX(fabsf(delta.y), fabsf(delta.z)));
+        int32_t steps = MAX(1, int32_t(ceilf(length / 0.5f)));
+        Vector3 step = delta * (1.0f / steps);
+
+        for(int32_t i = 0; i < steps; i++) {
+            moveAxis(1, step.y);
+
+            bool canStep = (wasGrounded || m_grounded) && step.y <= 0.0f;
+            for(int32_t axis = 0; axis < 3; axis += 2) {
+                float d = (axis == 0) ? step.x : step.z;
+                if(d == 0.0f || moveAxis(axis, d)) {
+                    continue;
+                }
+                if(canStep) {
+                    stepUp(axis, d);
+                }
+            }
+        }
+    }
+
+    bool isGrounded() const {
+        return m_grounded;
+    }
+
+    bool hitCeiling() const {
+        return m_hitCeiling;
+    }
+
+    // The body must never end up inside of the blocks
+    bool isStuck() const {
+        return overlaps(m_position);
+    }
+
+    Vector3 position() const {
+        return m_position;
+    }
+
+    void setPosition(const Vector3 &position) {
+        m_position = position;
+    }
+
+    Vector3 extent() const {
+        return m_extent;
+    }
+
+    void setExtent(const Vector3 &extent) {
+        m_extent = extent;
+    }
+
+    float stepHeight() const {
+        return m_stepHeight;
+    }
+
+    void setStepHeight(float height) {
+        m_stepHeight = height;
+    }
+
+protected:
+    // Returns false if the movement was blocked
+    bool moveAxis(int32_t axis, float d) {
+        if(d == 0.0f) {
+            return true;
+        }
+
+        Vector3 target = m_position;
+        target[axis] += d;
+
+        if(!overlaps(target)) {
+            m_position = target;
+            return true;
+        }
+
+        // Snap to the face of the blocking cell
+        if(d > 0.0f) {
+            m_position[axis] = floorf(target[axis] + m_extent[axis]) - m_extent[axis] - VOXEL_EPSILON;
+        } else {
+            m_position[axis] = floorf(target[axis] - m_extent[axis]) + 1.0f + m_extent[axis] + VOXEL_EPSILON;
+        }
+
+        if(axis == 1) {
+            if(d < 0.0f) {
+                m_grounded = true;
+            } else {
+                m_hitCeiling = true;
+            }
+        }
+        return false;
+    }
+
+    void stepUp(int32_t axis, float d) {
+        Vector3 raised = m_position;
+        raised.y += m_stepHeight;
+        if(overlaps(raised)) {
+            return;
+        }
+
+        raised[axis] += d;
+        if(overlaps(raised)) {
+            return;
+        }
+
+        // Settle down onto the step
+        m_position = raised;
+        moveAxis(1, -m_stepHeight);
+    }
+
+    bool overlaps(const Vector3 &position) const {
+        int32_t minX = int32_t(floorf(position.x - m_extent.x));
+        int32_t minY = int32_t(floorf(position.y - m_extent.y));
+        int32_t minZ = int32_t(floorf(position.z - m_extent.z));
+        int32_t maxX = int32_t(floorf(position.x + m_extent.x));
+        int32_t maxY = int32_t(floorf(position.y + m_extent.y));
+        int32_t maxZ = int32_t(floorf(position.z + m_extent.z));
+
+        for(int32_t y = minY; y <= maxY; y++) {
+            for(int32_t x = minX; x <= maxX; x++) {
+                for(int32_t z = minZ; z <= maxZ; z++) {
+                    if(isSolidAt(x, y, z)) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+};
+
+class VoxelRay {
+public:
+    // Walks the grid cells along the ray, returns the first collidable block and the cell in front of its face
+    static bool cast(const Vector3 &origin, const Vector3 &direction, float distance, int32_t hit[3], int32_t front[3]) {
+        int32_t cell[3] = {int32_t(floorf(origin.x)), int32_t(floorf(origin.y)), int32_t(floorf(origin.z))};
+        int32_t step[3];
+        float next[3];
+        float delta[3];
+
+        for(int32_t i = 0; i < 3; i++) {
+            float d = direction[i];
+            step[i] = (d > 0.0f) ? 1 : -1;
+            delta[i] = (d != 0.0f) ? fabsf(1.0f / d) : 1e30f;
+            float boundary = (d > 0.0f) ? (cell[i] + 1.0f - origin[i]) : (origin[i] - cell[i]);
+            next[i] = (d != 0.0f) ? boundary * delta[i] : 1e30f;
+        }
+
+        int32_t previous[3] = {cell[0], cell[1], cell[2]};
+        float t = 0.0f;
+        while(t <= distance) {
+            if(cell[1] >= 0 && cell[1] < CHUNK_HEIGHT && VoxelBody::isSolidAt(cell[0], cell[1], cell[2])) {
+                for(int32_t i = 0; i < 3; i++) {
+                    hit[i] = cell[i];
+                    front[i] = previous[i];
+                }
+                return true;
+            }
+
+            int32_t axis = (next[0] < next[1]) ? ((next[0] < next[2]) ? 0 : 2) : ((next[1] < next[2]) ? 1 : 2);
+            for(int32_t i = 0; i < 3; i++) {
+                previous[i] = cell[i];
+            }
+            t = next[axis];
+            next[axis] += delta[axis];
+            cell[axis] += step[axis];
+        }
+        return false;
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+
+#include "ChunkRenderer.cpp"
+
+struct BlockEdit {
+    int32_t x;
+    int32_t y;
+    int32_t z;
+    BlockType type;
+    BlockEdit *next;
+};
+
+// Many producers push edits without locking, the main thread takes the whole list at once
+class EditQueue {
+    std::atomic<BlockEdit *> m_head{nullptr};
+
+    std::atomic<uint64_t> m_pushed{0};
+
+public:
+    ~EditQueue() {
+        release(takeAll());
+    }
+
+    void push(int32_t x, int32_t y, int32_t z, BlockType type) {
+        BlockEdit *edit = new BlockEdit{x, y, z, type, m_head.load(std::memory_order_relaxed)};
+        while(!m_head.compare_exchange_weak(edit->next, edit, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Returns the edits in the order they were pushed, the caller owns the list
+    BlockEdit *takeAll() {
+        BlockEdit *head = m_head.exchange(nullptr, std::memory_order_acquire);
+
+        BlockEdit *result = nullptr;
+        while(head) {
+            BlockEdit *next = head->next;
+            head->next = result;
+            result = head;
+            head = next;
+        }
+        return result;
+    }
+
+    static void release(BlockEdit *edit) {
+        while(edit) {
+            BlockEdit *next = edit->next;
+            delete edit;
+            edit = next;
+        }
+    }
+
+    uint64_t pushed() const {
+        return m_pushed.load(std::memory_order_relaxed);
+    }
+};
+
+static EditQueue s_edits;
+
+// Thread safe access to the world for the code running outside of the main thread.
+// Only the main thread changes blocks and the chunk map, so it can keep reading without locks.
+// Lookups hold the shared map lock, the chunk itself is read under its own lock.
+class WorldAccess {
+public:
+    static BlockType readBlock(int32_t x, int32_t y, int32_t z) {
+        if(x < 0 || z < 0 || y < 0 || y >= CHUNK_HEIGHT) {
+            return BlockType::Air;
+        }
+
+        std::shared_lock<std::shared_mutex> map(s_chunksLock);
+        auto it = s_chunks.find(ChunkData::posToIndex(x / CHUNK_WIDTH, z / CHUNK_WIDTH));
+        if(it == s_chunks.end()) {
+            return BlockType::Air;
+        }
+
+        std::shared_lock<std::shared_mutex> guard(it->second.lock.mutex);
+        return ChunkRenderer::unpackType(it->second.blocks[ChunkData::blockIndex(x % CHUNK_WIDTH, y, z % CHUNK_WIDTH)]);
+    }
+
+    // Copies the chunk blocks so the caller can work on them without holding the lock
+    static bool snapshot(int32_t chunkX, int32_t chunkY, std::vector<uint32_t> &blocks, uint32_t *revision = nullptr) {
+        std::shared_lock<std::shared_mutex> map(s_chunksLock);
+        auto it = s_chunks.find(ChunkData::posToIndex(chunkX, chunkY));
+        if(it == s_chunks.end()) {
+            return false;
+        }
+
+        std::shared_lock<std::shared_mutex> guard(it->second.lock.mutex);
+        blocks = it->second.blocks;
+        if(revision) {
+            *revision = it->second.revision;
+        }
+        return true;
+    }
+
+    static uint32_t revision(int32_t chunkX, int32_t chunkY) {
+        std::shared_lock<std::shared_mutex> map(s_chunksLock);
+        auto it = s_chunks.find(ChunkData::posToIndex(chunkX, chunkY));
+        if(it == s_chunks.end()) {
+            return 0;
+        }
+
+        std::shared_lock<std::shared_mutex> guard(it->second.lock.mutex);
+        return it->second.revision;
+    }
+
+    // Edits are applied by the main thread on the next frame
+    static void queueEdit(int32_t x, int32_t y, int32_t z, BlockType type) {
+        s_edits.push(x, y, z, type);
+    }
+
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstring>
+
+#include "ChunkRenderer.cpp"
+#include "EditJournal.cpp"
+
+#define CACHE_MAGIC 0x31435754 // "TWC1"
+
+// Snapshot of the freshly generated spawn area with the chunk meshes, keyed by the seed and generator version
+class WorldCache {
+    std::vector<uint8_t> m_data;
+    std::vector<uint8_t> m_heights;
+
+    int32_t m_size = 0;
+
+public:
+    static std::string path(const std::string &directory, int32_t seed, uint32_t version) {
+        return directory + "/spawn_" + std::to_string(seed) + "_v" + std::to_string(version) + ".cache";
+    }
+
+    // Fills the chunk storage and the meshes, returns false if the cache is missing or doesn't match
+    bool load(const std::string &path, int32_t seed, uint32_t version, int32_t size, std::unordered_map<uint64_t, ChunkMeshCache> &meshes) {
+        std::ifstream file(path, std::ios::binary);
+        if(!file.is_open()) {
+            return false;
+        }
+
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        size_t position = 0;
+        uint32_t magic = 0;
+        if(!readRaw(data, position, &magic, sizeof(magic)) || magic != CACHE_MAGIC) {
+            return false;
+        }
+        if(EditJournal::readVarint(data, position) != version ||
+           JournalReader::unzigzag(EditJournal::readVarint(data, position)) != seed ||
+           EditJournal::readVarint(data, position) != uint32_t(size) ||
+           EditJournal::readVarint(data, position) != CHUNK_HEIGHT) {
+            return false;
+        }
+
+        m_size = size;
+        m_heights.resize(size * CHUNK_WIDTH * size * CHUNK_WIDTH);
+        if(!readRaw(data, position, m_heights.data(), m_heights.size())) {
+            return false;
+        }
+
+        uint32_t count = EditJournal::readVarint(data, position);
+        for(uint32_t i = 0; i < count; i++) {
+            int32_t x = EditJournal::readVarint(data, position);
+            int32_t y = EditJournal::readVarint(data, position);
+
+            ChunkData &chunk = s_chunks[ChunkData::posToIndex(x, y)];
+            chunk.x = x;
+            chunk.y = y;
+            chunk.blocks.resize(CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_WIDTH);
+            EditJournal::decodeRuns(data, position, &chunk.blocks);
+        }
+
+        count = EditJournal::readVarint(data, position);
+        for(uint32_t i = 0; i < count; i++) {
+            int32_t x = EditJournal::readVarint(data, position);
+            int32_t y = EditJournal::readVarint(data, position);
+
+            ChunkMeshCache &cache = meshes[ChunkData::posToIndex(x, y)];
+            if(!readMesh(data, position, cache.solid) || !readMesh(data, position, cache.translucent)) {
+                meshes.clear();
+                return false;
+            }
+
+            cache.instances.resize(EditJournal::readVarint(data, position));
+            for(auto &it : cache.instances) {
+                it.index = EditJournal::readVarint(data, position);
+                it.type = BlockType(EditJournal::readVarint(data, position));
+            }
+
+            if(!readArray(data, position, cache.sections)) {
+                meshes.clear();
+                return false;
+            }
+        }
+
+        return position == data.size();
+    }
+
+    // Must be called right after the generation, before any saved changes are applied
+    void storeBlocks(int32_t seed, uint32_t version, int32_t size) {
+        m_data.clear();
+        m_size = size;
+
+        uint32_t magic = CACHE_MAGIC;
+        m_data.insert(m_data.end(), reinterpret_cast<uint8_t *>(&magic), reinterpret_cast<uint8_t *>(&magic) + sizeof(magic));
+        EditJournal::writeVarint(m_data, version);
+        EditJournal::writeVarint(m_data, EditJournal::zigzag(seed));
+        EditJournal::writeVarint(m_data, size);
+        EditJournal::writeVarint(m_data, CHUNK_HEIGHT);
+
+        int32_t width = size * CHUNK_WIDTH;
+        m_heights.assign(width * width, 0);
+        for(int32_t x = 0; x < width; x++) {
+            for(int32_t z = 0; z < width; z++) {
+                for(int32_t y = CHUNK_HEIGHT - 1; y > 0; y--) {
+                    uint32_t *block = blockAt(x, y, z);
+                    if(block && ChunkRenderer::unpackType(*block) != BlockType::Air) {
+                        m_heights[z * width + x] = y;
+                        break;
+                    }
+                }
+            }
+        }
+        m_data.insert(m_data.end(), m_heights.begin(), m_heights.end());
+
+        EditJournal::writeVarint(m_data, s_chunks.size());
+        for(auto &it : s_chunks) {
+            EditJournal::writeVarint(m_data, it.second.x);
+            EditJournal::writeVarint(m_data, it.second.y);
+            EditJournal::encodeRuns(m_data, it.second.blocks);
+        }
+    }
+
+    // Only the chunks which match the generated blocks can be stored
+    void storeMeshes(const std::unordered_map<uint64_t, ChunkMeshCache> &meshes) {
+        EditJournal::writeVarint(m_data, meshes.size());
+        for(auto &it : meshes) {
+            const ChunkData &chunk = s_chunks[it.first];
+            EditJournal::writeVarint(m_data, chunk.x);
+            EditJournal::writeVarint(m_data, chunk.y);
+
+            writeMesh(it.second.solid);
+            writeMesh(it.second.translucent);
+
+            EditJournal::writeVarint(m_data, it.second.instances.size());
+            for(auto &instance : it.second.instances) {
+                EditJournal::writeVarint(m_data, instance.index);
+                EditJournal::writeVarint(m_data, uint32_t(instance.type));
+            }
+
+            writeArray(it.second.sections);
+        }
+    }
+
+    void save(const std::string &path) {
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char *>(m_data.data()), m_data.size());
+        }
+
+        // Never leave a partially written cache behind
+        std::error_code error;
+        std::filesystem::rename(temp, path, error);
+        m_data.clear();
+        m_data.shrink_to_fit();
+    }
+
+    // Top non air block of the generated terrain in world coordinates
+    int32_t height(int32_t x, int32_t z) const {
+        int32_t width = m_size * CHUNK_WIDTH;
+        if(x < 0 || z < 0 || x >= width || z >= width) {
+            return -1;
+        }
+        return m_heights[z * width + x];
+    }
+
+protected:
+    static bool readRaw(const std::vector<uint8_t> &data, size_t &position, void *value, size_t size) {
+        if(position + size > data.size()) {
+            return false;
+        }
+        memcpy(value, data.data() + position, size);
+        position += size;
+        return true;
+    }
+
+    template<typename T>
+    static bool readArray(const std::vector<uint8_t> &data, size_t &position, std::vector<T> &array) {
+        uint64_t count = EditJournal::readVarint(data, position);
+        if(position + count * sizeof(T) > data.size()) {
+            return false;
+        }
+        array.resize(count);
+        return readRaw(data, position, array.data(), count * sizeof(T));
+    }
+
+    template<typename T>
+    void writeArray(const std::vector<T> &array) {
+        EditJournal::writeVarint(m_data, array.size());
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(array.data());
+        m_data.insert(m_data.end(), bytes, bytes + array.size() * sizeof(T));
+    }
+
+    static bool readMesh(const std::vector<uint8_t> &data, size_t &position, MeshBuffers &mesh) {
+        return readArray(data, position, mesh.vertices) && readArray(data, position, mesh.uv0) &&
+               readArray(data, position, mesh.colors) && readArray(data, position, mesh.indices);
+    }
+
+    void writeMesh(const MeshBuffers &mesh) {
+        writeArray(mesh.vertices);
+        writeArray(mesh.uv0);
+        writeArray(mesh.colors);
+        writeArray(mesh.indices);
+    }
+
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include <engine.h>
+
+#define SIMULATION_RATE 20
+#define SIMULATION_CATCH_UP 4
+
+// Fixed rate clock of the world simulation, decoupled from the render frames
+class WorldClock {
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point m_tickStart;
+
+    float m_tickInterval = 1.0f / SIMULATION_RATE;
+    float m_tickBudget = 10.0f; // milliseconds
+    float m_accumulator = 0.0f;
+
+    uint64_t m_ticks = 0;
+    uint32_t m_overruns = 0;
+    uint32_t m_skippedTicks = 0;
+    uint32_t m_maxCatchUp = SIMULATION_CATCH_UP;
+
+public:
+    // Number of ticks due for the frame, a long frame runs a few ticks to catch up and drops the rest
+    uint32_t advance(float delta) {
+        m_accumulator += delta;
+
+        uint32_t count = uint32_t(m_accumulator / m_tickInterval);
+        if(count > m_maxCatchUp) {
+            m_skippedTicks += count - m_maxCatchUp;
+            m_accumulator -= (count - m_maxCatchUp) * m_tickInterval;
+            count = m_maxCatchUp;
+        }
+        m_accumulator -= count * m_tickInterval;
+        return count;
+    }
+
+    void beginTick() {
+        m_tickStart = Clock::now();
+    }
+
+    // Returns false if the tick took longer than its budget
+    bool endTick() {
+        m_ticks++;
+        if(Clock::now() > deadline()) {
+            m_overruns++;
+            return false;
+        }
+        return true;
+    }
+
+    // Ticks which didn't fit into the frame are moved to the next one
+    void postpone(uint32_t count) {
+        m_accumulator += count * m_tickInterval;
+    }
+
+    Clock::time_point deadline() const {
+        return m_tickStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(m_tickBudget));
+    }
+
+    // Position of the render frame between the last two ticks, used to interpolate the motion
+    float alpha() const {
+        return MIN(m_accumulator / m_tickInterval, 1.0f);
+    }
+
+    void reset() {
+        m_accumulator = 0.0f;
+        m_ticks = 0;
+        m_overruns = 0;
+        m_skippedTicks = 0;
+    }
+
+    float tickInterval() const {
+        return m_tickInterval;
+    }
+
+    void setTickRate(int32_t rate) {
+        m_tickInterval = 1.0f / MAX(rate, 1);
+    }
+
+    float tickBudget() const {
+        return m_tickBudget;
+    }
+
+    void setTickBudget(float budget) {
+        m_tickBudget = budget;
+    }
+
+    uint64_t ticks() const {
+        return m_ticks;
+    }
+
+    uint32_t overruns() const {
+        return m_overruns;
+    }
+
+    uint32_t skippedTicks() const {
+        return m_skippedTicks;
+    }
+
+};
+
+static WorldClock s_clock;
@@ -5,54 +5,188 @@
 #include <actor.h>
 #include <scene.h>
 #include <transform.h>
+#include <timer.h>
 #include <log.h>
 #include "ChunkRenderer.cpp"
+#include "ChunkPool.cpp"
+#include "MesherCheck.cpp"
+#include "FluidCheck.cpp"
+#include "AccessCheck.cpp"
+#include "PhysicsCheck.cpp"
+#include "FluidSimulator.cpp"
+#include "BlockTicker.cpp"
+#include "WorldAccess.cpp"
+#include "StructureGenerator.cpp"
+#include "Noise.cpp"
+#include "WorldCache.cpp"
+#include "WorldClock.cpp"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
 
 #define SIZE 7
+#define JOURNAL_COMPACT_SIZE (4 * 1024 * 1024)
+// Bump on any change of the generation, makes the cached spawn areas obsolete
+#define GENERATOR_VERSION 5
 
 class WorldManager : public NativeBehaviour {
     A_OBJECT(WorldManager, NativeBehaviour, Components)
 
     A_PROPERTIES(
         A_PROPERTY(Prefab *, chunkPrefab, WorldManager::chunkPrefab, WorldManager::setChunkPrefab),
-        A_PROPERTY(Prefab *, playerPrefab, WorldManager::playerPrefab, WorldManager::setPlayerPrefab)
+        A_PROPERTY(Prefab *, playerPrefab, WorldManager::playerPrefab, WorldManager::setPlayerPrefab),
+        A_PROPERTY(int, seed, WorldManager::seed, WorldManager::setSeed),
+        A_PROPERTY(int, fluidTickPeriod, WorldManager::fluidTickPeriod, WorldManager::setFluidTickPeriod),
+        A_PROPERTY(float, fluidTickTimeBudget, WorldManager::fluidTickTimeBudget, WorldManager::setFluidTickTimeBudget),
+        A_PROPERTY(int, fluidTickBudget, WorldManager::fluidTickBudget, WorldManager::setFluidTickBudget),
+        A_PROPERTY(int, randomTickSpeed, WorldManager::randomTickSpeed, WorldManager::setRandomTickSpeed),
+        A_PROPERTY(bool, verifyMesher, WorldManager::verifyMesher, WorldManager::setVerifyMesher),
+        A_PROPERTY(bool, verifyFluids, WorldManager::verifyFluids, WorldManager::setVerifyFluids),
+        A_PROPERTY(bool, verifyAccess, WorldManager::verifyAccess, WorldManager::setVerifyAccess),
+        A_PROPERTY(bool, verifyPhysics, WorldManager::verifyPhysics, WorldManager::setVerifyPhysics),
+        A_PROPERTY(int, simulationRate, WorldManager::simulationRate, WorldManager::setSimulationRate),
+        A_PROPERTY(float, simulationBudget, WorldManager::simulationBudget, WorldManager::setSimulationBudget),
+        A_PROPERTY(bool, replica, WorldManager::replica, WorldManager::setReplica)
     )
 
     Prefab *m_chunkPrefab = nullptr;
     Prefab *m_playerPrefab = nullptr;
 
+    int m_seed = 0;
+
+    bool m_verifyMesher = false;
+    bool m_verifyFluids = false;
+    bool m_verifyAccess = false;
+    bool m_verifyPhysics = false;
+
+    // Replicas show the world simulated by another process, following its journal
+    bool m_replica = false;
+    JournalReader m_follower;
+    uint32_t m_followerRestarts = 0;
+
+    ChunkPool m_chunkPool;
+
 public:
     // Use this to initialize behaviour
     void start() override {
-        s_chunks.clear();
+        s_journal.close();
+        // Restarting the world reuses the chunk objects of the previous run
+        m_chunkPool.releaseAll();
+        {
+            std::unique_lock<std::shared_mutex> guard(s_chunksLock);
+            s_chunks.clear();
+        }
+        s_dirtySections.clear();
+        s_fluids.clear();
+        s_ticker.clear();
+        s_clock.reset();
+        s_ticker.setTreeGenerator(&WorldManager::generateTree);
+
+#ifndef NDEBUG
+        if(!runChecks()) {
+            aError() << "World self checks failed, see the errors above";
+        }
+#endif
 
         if(m_chunkPrefab) {
-            // Generate world
-            for(int x = 0; x < SIZE; x++) {
-                for(int y = 0; y < SIZE; y++) {
-                    s_chunks[ChunkData::posToIndex(x, y)] = generateChunk(x, y);
+            srand(m_seed);
+
+            auto start = std::chrono::steady_clock::now();
+
+            std::string directory = Engine::locationAppConfig().toStdString() + "/world";
+            std::string cachePath = WorldCache::path(directory, m_seed, GENERATOR_VERSION);
+
+            WorldCache cache;
+            std::unordered_map<uint64_t, ChunkMeshCache> meshes;
+
+            // The chunk map is filled while the other threads are locked out
+            std::unique_lock<std::shared_mutex> guard(s_chunksLock);
+            bool cached = cache.load(cachePath, m_seed, GENERATOR_VERSION, SIZE, meshes);
+            if(!cached) {
+                s_chunks.clear();
+                meshes.clear();
+
+                // Generate world
+                generateChunks(m_seed);
+
+                // Generate structures
+                for(int x = 0; x < SIZE; x++) {
+                    for(int y = 0; y < SIZE; y++) {
+                        generateStructures(x, y);
+                    }
                 }
+
+                cache.storeBlocks(m_seed, GENERATOR_VERSION, SIZE);
             }
 
-            // Generate structures
-            for(int x = 0; x < SIZE; x++) {
-                for(int y = 0; y < SIZE; y++) {
-                    generateStructures(x, y);
+            // Restore the changes made in the previous sessions, cached meshes of the changed chunks and their neighbours are stale
+            std::unordered_set<uint64_t> changed;
+            auto touch = [&changed](int32_t x, int32_t y) {
+                changed.insert(ChunkData::posToIndex(x, y));
+                changed.insert(ChunkData::posToIndex(x - 1, y));
+                changed.insert(ChunkData::posToIndex(x + 1, y));
+                changed.insert(ChunkData::posToIndex(x, y - 1));
+                changed.insert(ChunkData::posToIndex(x, y + 1));
+            };
+
+            // Changes made to the worlds of the other seeds are kept apart
+            s_journal.open(directory + "/" + std::to_string(m_seed), !m_replica);
+            s_journal.loadRegions([&touch](int32_t x, int32_t y) -> std::vector<uint32_t> * {
+                auto it = s_chunks.find(ChunkData::posToIndex(x, y));
+                if(it == s_chunks.end()) {
+                    return nullptr;
                 }
+                touch(x, y);
+                return &it->second.blocks;
+            });
+            if(m_replica) {
+                m_follower.reset();
+                m_followerRestarts = m_follower.restarts();
+                followJournal(touch);
+            } else {
+                s_journal.replay([&touch](const JournalRecord &record) {
+                    touch(record.chunkX, record.chunkY);
+                    applyRecord(s_chunks, record);
+                });
+                s_journal.setRecording(true);
+            }
+
+            for(auto &it : s_chunks) {
+                it.second.recount();
             }
+            guard.unlock();
 
             // Set world to render
             for(int x = 0; x < SIZE; x++) {
                 for(int y = 0; y < SIZE; y++) {
-                    Actor* object = static_cast<Actor*>(m_chunkPrefab->actor()->clone(actor()));
-                    object->transform()->setPosition(Vector3(x * CHUNK_WIDTH, 0.0f, y * CHUNK_WIDTH));
-                    ChunkRenderer* chunk = object->getComponent<ChunkRenderer>();
+                    ChunkRenderer* chunk = m_chunkPool.acquire(m_chunkPrefab, actor());
                     if(chunk) {
-                        chunk->setChunkData(s_chunks[ChunkData::posToIndex(x, y)]);
+                        chunk->actor()->transform()->setPosition(Vector3(x * CHUNK_WIDTH, 0.0f, y * CHUNK_WIDTH));
+                        uint64_t key = ChunkData::posToIndex(x, y);
+                        auto mesh = meshes.find(key);
+                        if(cached && mesh != meshes.end() && changed.count(key) == 0) {
+                            chunk->setChunkData(s_chunks[key], mesh->second);
+                        } else {
+                            chunk->setChunkData(s_chunks[key]);
+                            if(!cached && changed.count(key) == 0) {
+                                chunk->exportMeshes(meshes[key]);
+                            }
+                        }
                     }
                 }
             }
 
+            if(!cached) {
+                cache.storeMeshes(meshes);
+                cache.save(cachePath);
+            }
+
+            std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+            aInfo() << (cached ? "Loaded" : "Generated") << "spawn area in" << elapsed.count() * 1000.0f << "ms";
+            aInfo() << "Chunk pool hit rate" << m_chunkPool.hitRate() << "resident" << int(m_chunkPool.residentBytes() / 1024) << "KB";
+
             // Spawn player
             if(m_playerPrefab) {
                 Actor *object = static_cast<Actor *>(m_playerPrefab->actor()->clone(actor()->scene()));
@@ -61,31 +195,160 @@ public:
                 ChunkData &data = s_chunks[ChunkData::posToIndex(chunkXZ, chunkXZ)];
 
                 uint32_t xz0 = xz % CHUNK_WIDTH;
-                int y = CHUNK_HEIGHT-1;
-                while(ChunkRenderer::unpackType(data.blocks[xz0 + CHUNK_WIDTH * (y * CHUNK_WIDTH + xz0)]) == BlockType::Air) {
-                    y--;
+                int y = cache.height(xz, xz);
+                if(y < 0 || changed.count(ChunkData::posToIndex(chunkXZ, chunkXZ)) != 0) {
+                    // Saved changes could have built something over the terrain
+                    y = data.height[xz0 + xz0 * CHUNK_WIDTH];
                 }
                 object->transform()->setPosition(Vector3(xz, y+3, xz));
             }
         }
     }
 
+    // Self checks of the debug builds, each of them runs on its own scratch world before the real one is loaded
+    bool runChecks() {
+        bool result = true;
+        if(m_verifyMesher) {
+            result &= MesherCheck::run(m_seed, 100);
+        }
+        if(m_verifyFluids) {
+            result &= FluidCheck::run(m_seed, s_fluids.tickTimeBudget());
+        }
+        if(m_verifyAccess) {
+            result &= AccessCheck::run(m_seed);
+        }
+        if(m_verifyPhysics) {
+            result &= PhysicsCheck::run(m_seed, SIZE, s_clock.tickInterval(), &WorldManager::generateChunks);
+        }
+        return result;
+    }
+
     // Will be called each frame. Use this to write your game logic
     void update() override {
+        uint32_t ticks = s_clock.advance(Timer::deltaTime());
+        for(uint32_t i = 0; i < ticks; i++) {
+            if(!simulationTick()) {
+                // Heavy world work slows the simulation down instead of stalling the frame
+                s_clock.postpone(ticks - i - 1);
+                if(s_clock.overruns() % 100 == 1) {
+                    aWarning() << "World tick is over budget," << int(s_clock.overruns()) << "overruns," << int(s_clock.skippedTicks()) << "skipped ticks";
+                }
+                break;
+            }
+        }
+    }
 
+    // Edits, block ticks, fluids and chunk rebuilds run at the fixed rate of the world clock
+    bool simulationTick() {
+        s_clock.beginTick();
+
+        if(m_replica) {
+            // Nothing is simulated locally, the edits of the local player are dropped
+            EditQueue::release(s_edits.takeAll());
+            followJournal([](int32_t, int32_t) {});
+            rebuildDirtyChunks(s_clock.deadline());
+            return s_clock.endTick();
+        }
+
+        applyQueuedEdits();
+
+        s_fluids.update();
+        s_ticker.tick();
+
+        rebuildDirtyChunks(s_clock.deadline());
+
+        s_journal.setTick(s_ticker.currentTick());
+        s_journal.flush();
+        if(s_journal.size() > JOURNAL_COMPACT_SIZE) {
+            compactJournal();
+        }
+
+        return s_clock.endTick();
     }
     
-    static void changeBlock(int32_t x, int32_t y, int32_t z, BlockType newType) {
-        int chunkX = x / CHUNK_WIDTH;
-        int chunkY = z / CHUNK_WIDTH;
+    // Edits queued by the other threads are batched into the common rebuild
+    static void applyQueuedEdits() {
+        BlockEdit *edits = s_edits.takeAll();
+        for(BlockEdit *edit = edits; edit; edit = edit->next) {
+            uint32_t *block = blockAt(edit->x, edit->y, edit->z);
+            if(block == nullptr || ChunkRenderer::unpackType(*block) == BlockType::Bedrock) {
+                continue;
+            }
+
+            BlockType oldType = ChunkRenderer::unpackType(*block);
+            uint32_t value = 0;
+            ChunkRenderer::packType(value, edit->type);
+
+            ChunkData &data = s_chunks[ChunkData::posToIndex(edit->x / CHUNK_WIDTH, edit->z / CHUNK_WIDTH)];
+            size_t index = ChunkData::blockIndex(edit->x % CHUNK_WIDTH, edit->y, edit->z % CHUNK_WIDTH);
+            data.write(index, value);
+            if(data.renderer == nullptr || !data.renderer->updateInstance(index, oldType, edit->type)) {
+                markBlockDirty(edit->x, edit->y, edit->z);
+            }
+
+            s_fluids.notifyChange(edit->x, edit->y, edit->z);
+            // Let grass below react to the block placed or removed on top of it
+            s_ticker.scheduleTick(edit->x, edit->y - 1, edit->z, 20 + rand() % 40);
+        }
+        EditQueue::release(edits);
+    }
+
+    // Used for the journal replay and by the replicas following the journal of another process
+    static void applyRecord(std::unordered_map<uint64_t, ChunkData> &world, const JournalRecord &record) {
+        auto it = world.find(ChunkData::posToIndex(record.chunkX, record.chunkY));
+        if(it != world.end() && record.index < it->second.blocks.size()) {
+            it->second.exchange(record.index, record.newBlock);
+        }
+    }
+
+    // Applies the records appended to the journal by the simulating process since the last call
+    void followJournal(const std::function<void(int32_t, int32_t)> &touched) {
+        if(!m_follower.poll(s_journal.journalPath())) {
+            return;
+        }
+        if(m_follower.restarts() != m_followerRestarts) {
+            m_followerRestarts = m_follower.restarts();
+            reloadRegions();
+        }
+
+        JournalRecord record;
+        while(m_follower.next(record)) {
+            touched(record.chunkX, record.chunkY);
+            applyRecord(s_chunks, record);
+
+            int32_t x = record.index % CHUNK_WIDTH;
+            int32_t z = (record.index / CHUNK_WIDTH) % CHUNK_WIDTH;
+            int32_t y = record.index / (CHUNK_WIDTH * CHUNK_WIDTH);
+            markBlockDirty(record.chunkX * CHUNK_WIDTH + x, y, record.chunkY * CHUNK_WIDTH + z);
+        }
+    }
 
-        auto it = s_chunks.find(ChunkData::posToIndex(chunkX, chunkY));
-        
-        if (it != s_chunks.end()) {
-            it->second.renderer->changeBlock(x, y, z, newType);
+    // The journal was compacted by the simulating process, the records missed meanwhile were folded into the regions
+    static void reloadRegions() {
+        std::unique_lock<std::shared_mutex> guard(s_chunksLock);
+        std::vector<ChunkData *> loaded;
+        s_journal.loadRegions([&loaded](int32_t x, int32_t y) -> std::vector<uint32_t> * {
+            auto it = s_chunks.find(ChunkData::posToIndex(x, y));
+            if(it == s_chunks.end()) {
+                return nullptr;
+            }
+            loaded.push_back(&it->second);
+            return &it->second.blocks;
+        });
+        for(auto it : loaded) {
+            it->recount();
+            it->revision++;
+            markBoxDirty(it->x * CHUNK_WIDTH, 0, it->y * CHUNK_WIDTH, it->x * CHUNK_WIDTH + CHUNK_WIDTH - 1, CHUNK_HEIGHT - 1, it->y * CHUNK_WIDTH + CHUNK_WIDTH - 1);
         }
     }
 
+    static void compactJournal() {
+        s_journal.compact([](int32_t x, int32_t y) -> const std::vector<uint32_t> * {
+            auto it = s_chunks.find(ChunkData::posToIndex(x, y));
+            return (it != s_chunks.end()) ? &it->second.blocks : nullptr;
+        });
+    }
+
     Prefab *chunkPrefab() const {
         return m_chunkPrefab;
     }
@@ -94,6 +357,14 @@ public:
         m_chunkPrefab = prefab;
     }
 
+    int seed() const {
+        return m_seed;
+    }
+
+    void setSeed(int seed) {
+        m_seed = seed;
+    }
+
     Prefab *playerPrefab() const {
         return m_playerPrefab;
     }
@@ -102,12 +373,144 @@ public:
         m_playerPrefab = prefab;
     }
 
-    static ChunkData generateChunk(int32_t posX, int32_t posY) {
+    int fluidTickPeriod() const {
+        return s_fluids.tickPeriod();
+    }
+
+    void setFluidTickPeriod(int period) {
+        s_fluids.setTickPeriod(MAX(period, 1));
+    }
+
+    float fluidTickTimeBudget() const {
+        return s_fluids.tickTimeBudget();
+    }
+
+    void setFluidTickTimeBudget(float budget) {
+        s_fluids.setTickTimeBudget(budget);
+    }
+
+    int randomTickSpeed() const {
+        return s_ticker.randomTickSpeed();
+    }
+
+    void setRandomTickSpeed(int speed) {
+        s_ticker.setRandomTickSpeed(MAX(speed, 0));
+    }
+
+    int fluidTickBudget() const {
+        return s_fluids.tickBudget();
+    }
+
+    void setFluidTickBudget(int budget) {
+        s_fluids.setTickBudget(MAX(budget, 1));
+    }
+
+    bool verifyMesher() const {
+        return m_verifyMesher;
+    }
+
+    void setVerifyMesher(bool verify) {
+        m_verifyMesher = verify;
+    }
+
+    bool verifyFluids() const {
+        return m_verifyFluids;
+    }
+
+    void setVerifyFluids(bool verify) {
+        m_verifyFluids = verify;
+    }
+
+    bool verifyAccess() const {
+        return m_verifyAccess;
+    }
+
+    void setVerifyAccess(bool verify) {
+        m_verifyAccess = verify;
+    }
+
+    bool verifyPhysics() const {
+        return m_verifyPhysics;
+    }
+
+    void setVerifyPhysics(bool verify) {
+        m_verifyPhysics = verify;
+    }
+
+    int simulationRate() const {
+        return int(roundf(1.0f / s_clock.tickInterval()));
+    }
+
+    void setSimulationRate(int rate) {
+        s_clock.setTickRate(rate);
+    }
+
+    bool replica() const {
+        return m_replica;
+    }
+
+    void setReplica(bool replica) {
+        m_replica = replica;
+    }
+
+    float simulationBudget() const {
+        return s_clock.tickBudget();
+    }
+
+    void setSimulationBudget(float budget) {
+        s_clock.setTickBudget(MAX(budget, 0.0f));
+    }
+
+    // Chunks don't depend on each other so they are generated on all the available cores
+    static void generateChunks(int32_t seed) {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<ChunkData> chunks(SIZE * SIZE);
+        std::atomic<int32_t> next(0);
+
+        auto worker = [&chunks, &next, seed]() {
+            int32_t i;
+            while((i = next.fetch_add(1)) < SIZE * SIZE) {
+                chunks[i] = generateChunk(i % SIZE, i / SIZE, seed);
+            }
+        };
+
+        std::vector<std::thread> threads(MAX(1U, MIN(std::thread::hardware_concurrency(), uint32_t(SIZE * SIZE))) - 1);
+        for(auto &it : threads) {
+            it = std::thread(worker);
+        }
+        worker();
+        for(auto &it : threads) {
+            it.join();
+        }
+
+        for(auto &it : chunks) {
+            s_chunks[ChunkData::posToIndex(it.x, it.y)] = std::move(it);
+        }
+        for(auto &it : chunks) {
+            markChunkLoaded(it.x, it.y);
+        }
+
+        std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+        aInfo() << "Generated" << SIZE * SIZE << "chunks on" << int(threads.size() + 1) << "threads," << (SIZE * SIZE) / MAX(elapsed.count(), 0.0001f) << "chunks/s";
+    }
+
+    static ChunkData generateChunk(int32_t posX, int32_t posY, int32_t seed = 0) {
+        std::minstd_rand random(Noise::hash(seed, posX, 0, posY));
+
         ChunkData result;
+        result.x = posX;
+        result.y = posY;
         result.blocks.resize(CHUNK_WIDTH * CHUNK_WIDTH * CHUNK_HEIGHT);
+
+        int32_t heights[CHUNK_WIDTH * CHUNK_WIDTH];
+        int32_t maxHeight = 0;
         for(int32_t x = 0; x < CHUNK_WIDTH; x++) {
             for(int32_t z = 0; z < CHUNK_WIDTH; z++) {
                 int height = Mathf::perlinNoise((x + posX * CHUNK_WIDTH) * 0.1f, (z + posY * CHUNK_WIDTH) * 0.1f) * 20.0f + 20.0f;
+                height = MIN(height, CHUNK_HEIGHT - 1);
+                heights[x + z * CHUNK_WIDTH] = height;
+                maxHeight = MAX(maxHeight, height);
                 for(int32_t y = 0; y < height; y++) {
                     BlockType type = BlockType::Bedrock;
                     if(y > 2) {
@@ -116,9 +519,20 @@ public:
                             if(y == height-1) {
                                 type = BlockType::Grass;
 
-                                if(y < CHUNK_HEIGHT-1 && (rand() % 10) == 0) {
-                                    size_t index = x + CHUNK_WIDTH * ((y+1) * CHUNK_WIDTH + z);
-                                    ChunkRenderer::packType(result.blocks[index], (rand() % 30 == 0) ? BlockType::Sapling : BlockType::TallGrass);
+                                if(y < CHUNK_HEIGHT-1) {
+                                    uint32_t index = x + CHUNK_WIDTH * ((y+1) * CHUNK_WIDTH + z);
+                                    if((random() % 10) == 0) {
+                                        if(random() % 30 == 0) {
+                                            ChunkRenderer::packType(result.blocks[index], BlockType::Sapling);
+                                            result.sites.push_back({index, uint8_t(random() % 3)});
+                                        } else {
+                                            ChunkRenderer::packType(result.blocks[index], BlockType::TallGrass);
+                                        }
+                                    } else if(random() % 400 == 0) {
+                                        result.sites.push_back({index, uint8_t(StructureType::Boulder)});
+                                    } else if(random() % 4000 == 0) {
+                                        result.sites.push_back({index, uint8_t(StructureType::Hut)});
+                                    }
                                 }
                             }
                         } else {
@@ -127,78 +541,109 @@ public:
                     }
 
                     ChunkRenderer::packType(result.blocks[x + CHUNK_WIDTH * (y * CHUNK_WIDTH + z)], type);
-                    result.x = posX;
-                    result.y = posY;
                 }
             }
         }
+
+        carveCaves(result, heights, maxHeight, seed);
+        placeOres(result, heights, random);
+
+        result.recount();
+
         return result;
     }
 
-    static void generateStructures(int32_t posX, int32_t posY) {
-        ChunkData &data = s_chunks[ChunkData::posToIndex(posX, posY)];
+    static void carveCaves(ChunkData &data, const int32_t *heights, int32_t maxHeight, int32_t seed) {
+        // Tunnels are where both noise fields are close to zero
+        NoiseLattice first;
+        NoiseLattice second;
+        first.sample(seed, data.x, data.y, maxHeight, 0.06f, 0.09f);
+        second.sample(seed + 1, data.x, data.y, maxHeight, 0.06f, 0.09f);
 
         for(int32_t x = 0; x < CHUNK_WIDTH; x++) {
             for(int32_t z = 0; z < CHUNK_WIDTH; z++) {
-                for(int32_t y = 0; y < CHUNK_HEIGHT; y++) {
-                    size_t index = x + CHUNK_WIDTH * (y * CHUNK_WIDTH + z);
-
-                    if(ChunkRenderer::unpackType(data.blocks[index]) == BlockType::Sapling) {
-                        generateTree(data.x * CHUNK_WIDTH + x, y, data.y * CHUNK_WIDTH + z);
+                // Caves stay under the dirt layer so they don't break the surface
+                int32_t top = heights[x + z * CHUNK_WIDTH] - 3;
+                for(int32_t y = 4; y < top; y++) {
+                    float a = first.value(x, y, z);
+                    float b = second.value(x, y, z);
+                    if(a * a + b * b < 0.008f) {
+                        ChunkRenderer::packType(data.blocks[ChunkData::blockIndex(x, y, z)], BlockType::Air);
                     }
                 }
             }
         }
-
     }
 
-    static void generateTree(int32_t x, int32_t y, int32_t z) {
-        int chunkX = x / CHUNK_WIDTH;
-        int chunkY = z / CHUNK_WIDTH;
-
-        uint32_t x0 = x % CHUNK_WIDTH;
-        uint32_t z0 = z % CHUNK_WIDTH;
+    static void placeOres(ChunkData &data, const int32_t *heights, std::minstd_rand &random) {
+        struct Ore {
+            BlockType type;
+            int32_t veins;
+            int32_t maxY;
+            int32_t size;
+        };
+        const Ore ores[] = {
+            {BlockType::CoalOre, 20, 128, 8},
+            {BlockType::IronOre, 12, 40, 6},
+            {BlockType::GoldOre, 3, 20, 5},
+        };
+
+        for(auto &ore : ores) {
+            for(int32_t v = 0; v < ore.veins; v++) {
+                int32_t x = random() % CHUNK_WIDTH;
+                int32_t z = random() % CHUNK_WIDTH;
+                int32_t top = MIN(ore.maxY, heights[x + z * CHUNK_WIDTH] - 3);
+                if(top <= 4) {
+                    continue;
+                }
+                int32_t y = 4 + random() % (top - 4);
 
-        int32_t height = 7;
+                // Random walk replacing the stone on its way
+                for(int32_t i = 0; i < ore.size; i++) {
+                    size_t index = ChunkData::blockIndex(x, y, z);
+                    if(ChunkRenderer::unpackType(data.blocks[index]) == BlockType::Stone) {
+                        ChunkRenderer::packType(data.blocks[index], ore.type);
+                    }
 
-        if(height == 0) {
-            return;
+                    uint32_t r = random();
+                    int32_t d = (r & 1) ? 1 : -1;
+                    switch((r >> 1) % 3) {
+                    case 0: x = MAX(0, MIN(x + d, CHUNK_WIDTH - 1)); break;
+                    case 1: y = MAX(4, MIN(y + d, top)); break;
+                    default: z = MAX(0, MIN(z + d, CHUNK_WIDTH - 1)); break;
+                    }
+                }
+            }
         }
+    }
 
-        // Leaves
-        for(int32_t radius = 1; radius < 4; radius++) {
-            for(int32_t i = -radius; i <= radius; i++) {
-                for(int32_t j = -radius; j <= radius; j++) {
-                    float distance = sqrt(i*i + j*j)-0.2f;
-                    if(distance < radius) {
-                        if((x + i) < 0 || (z + j) < 0) {
-                            continue;
-                        }
-                        int32_t chunkX = (x + i) / CHUNK_WIDTH;
-                        int32_t chunkY = (z + j) / CHUNK_WIDTH;
-
-                        auto it = s_chunks.find(ChunkData::posToIndex(chunkX, chunkY));
-                        if(it != s_chunks.end())  {
-                            uint32_t x0 = (x + i) % CHUNK_WIDTH;
-                            uint32_t z0 = (z + j) % CHUNK_WIDTH;
+    static void generateStructures(int32_t posX, int32_t posY) {
+        ChunkData &data = s_chunks[ChunkData::posToIndex(posX, posY)];
 
-                            size_t index = x0 + CHUNK_WIDTH * ((y + height - radius) * CHUNK_WIDTH + z0);
-                            if(it->second.blocks[index] == (uint32_t)BlockType::Air) {
-                                ChunkRenderer::packType(it->second.blocks[index], BlockType::Leaves);
-                            }
-                        }
-                    }
+        // Sites are recorded by the terrain generator, no need to scan the blocks
+        for(auto &it : data.sites) {
+            int32_t x = it.index % CHUNK_WIDTH;
+            int32_t z = (it.index / CHUNK_WIDTH) % CHUNK_WIDTH;
+            int32_t y = it.index / (CHUNK_WIDTH * CHUNK_WIDTH);
+
+            StructureType type = StructureType(it.type);
+            if(StructureGenerator::isTree(type)) {
+                // Part of the saplings is left to grow during the game
+                if(ChunkRenderer::unpackType(data.blocks[it.index]) != BlockType::Sapling || (rand() % 3) == 0) {
+                    continue;
                 }
             }
+            s_structures.place(type, data.x * CHUNK_WIDTH + x, y, data.y * CHUNK_WIDTH + z);
         }
+        data.sites.clear();
+    }
 
-        // Trunk
-        ChunkData &data = s_chunks[ChunkData::posToIndex(chunkX, chunkY)];
-        for(int32_t i = 0; i < height-1; i++) {
-            size_t index = x0 + CHUNK_WIDTH * ((y + i) * CHUNK_WIDTH + z0);
-            ChunkRenderer::packType(data.blocks[index], BlockType::Log);
+    static void generateTree(int32_t x, int32_t y, int32_t z) {
+        uint32_t hash = (uint32_t(x) * 73856093U) ^ (uint32_t(z) * 83492791U);
+        StructureType type = StructureType(hash % 3);
+        if(s_structures.fits(type, x, y, z)) {
+            s_structures.place(type, x, y, z);
         }
-
     }
 
 };